@@ -0,0 +1,534 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+// correct way to include Consumer/Producer API headers
+//#include <Consumer-Producer-API/cs.hpp>
+#include "cs.hpp"
+
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/util/sha256.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <iostream>
+#include <list>
+#include <map>
+#include <queue>
+
+// Enclosing code in ndn simplifies coding (can also use `using namespace ndn`)
+namespace ndn {
+// Additional nested namespace could be used to prevent/limit name contentions
+namespace examples {
+
+#define N_ENTRIES 65536
+#define N_LOOKUPS 1000000
+#define PREFIX "/cs/performance"
+
+#define LIST_SKIPLIST_MAX_LAYERS 32
+#define LIST_SKIPLIST_PROBABILITY 25 // 25% (p = 1/4)
+
+// The send buffer as it was before the sharded skip list: one lock, layers of std::list,
+// Names compared component by component and a map of per-layer iterators in every entry.
+// Only what the benchmark measures is kept: insert with FIFO eviction and exact-name find.
+class ListSkipList : noncopyable
+{
+public:
+  explicit
+  ListSkipList(size_t nMaxPackets)
+    : m_nMaxPackets(nMaxPackets)
+  {
+    m_skipList.push_back(new Layer());
+
+    for (size_t i = 0; i < m_nMaxPackets; i++)
+      m_freeEntries.push(new Entry());
+  }
+
+  ~ListSkipList()
+  {
+    while (evictItem())
+      ;
+
+    while (!m_freeEntries.empty()) {
+      delete m_freeEntries.front();
+      m_freeEntries.pop();
+    }
+
+    for (SkipList::iterator it = m_skipList.begin(); it != m_skipList.end(); ++it)
+      delete *it;
+  }
+
+  bool
+  insert(const Data& data, const ConstBufferPtr& digest)
+  {
+    if (m_cleanupIndex.size() >= m_nMaxPackets)
+      evictItem();
+
+    std::pair<Entry*, bool> entry = insertToSkipList(data, digest);
+    if (entry.second)
+      m_cleanupIndex.push_back(entry.first);
+
+    return entry.second;
+  }
+
+  const Data*
+  find(const Interest& interest)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+
+    bool isIterated = false;
+    SkipList::const_reverse_iterator topLayer = m_skipList.rbegin();
+    Layer::iterator head = (*topLayer)->begin();
+
+    if ((*topLayer)->empty())
+      return 0;
+
+    //start from the upper layer towards bottom
+    int layer = m_skipList.size() - 1;
+    for (SkipList::const_reverse_iterator rit = topLayer; rit != m_skipList.rend(); ++rit) {
+      if (!isIterated)
+        head = (*rit)->begin();
+
+      if (head != (*rit)->end()) {
+        if (!isIterated && interest.getName().isPrefixOf((*head)->name)) {
+          if (layer > 0) {
+            layer--;
+            continue;
+          }
+          isIterated = true;
+        }
+        else {
+          Layer::iterator it = head;
+          while ((*it)->name < interest.getName()) {
+            head = it;
+            isIterated = true;
+
+            ++it;
+            if (it == (*rit)->end())
+              break;
+          }
+        }
+      }
+
+      if (layer > 0) {
+        head = (*head)->iterators.find(layer - 1)->second; // move HEAD to the lower layer
+      }
+      else if (isIterated) {
+        // leftmost child: the first entry under the Interest name
+        for (Layer::iterator it = head; it != (*rit)->end(); ++it) {
+          if (interest.getName().isPrefixOf((*it)->name))
+            return (*it)->data.get();
+          if (it != head)
+            break;
+        }
+        return 0;
+      }
+
+      layer--;
+    }
+
+    return 0;
+  }
+
+private:
+  struct Entry;
+  typedef std::list<Entry*> Layer;
+  typedef std::list<Layer*> SkipList;
+
+  struct Entry
+  {
+    shared_ptr<const Data> data;
+    Name name; // with implicit digest
+    std::map<int, Layer::iterator> iterators;
+  };
+
+  std::pair<Entry*, bool>
+  insertToSkipList(const Data& data, const ConstBufferPtr& digest)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+
+    Entry* entry = m_freeEntries.front();
+    m_freeEntries.pop();
+    entry->data = data.shared_from_this();
+    entry->name = data.getName();
+    entry->name.append(name::Component(digest));
+
+    bool insertInFront = false;
+    bool isIterated = false;
+    SkipList::reverse_iterator topLayer = m_skipList.rbegin();
+    Layer::iterator updateTable[LIST_SKIPLIST_MAX_LAYERS + 1];
+    Layer::iterator head = (*topLayer)->begin();
+
+    if (!(*topLayer)->empty()) {
+      //start from the upper layer towards bottom
+      int layer = m_skipList.size() - 1;
+      for (SkipList::reverse_iterator rit = topLayer; rit != m_skipList.rend(); ++rit) {
+        if (!isIterated)
+          head = (*rit)->begin();
+
+        updateTable[layer] = head;
+
+        if (head != (*rit)->end()) {
+          if (!isIterated && (*head)->name >= entry->name) {
+            --updateTable[layer];
+            insertInFront = true;
+          }
+          else {
+            Layer::iterator it = head;
+            while ((*it)->name < entry->name) {
+              head = it;
+              updateTable[layer] = it;
+              isIterated = true;
+
+              ++it;
+              if (it == (*rit)->end())
+                break;
+            }
+          }
+        }
+
+        if (layer > 0)
+          head = (*head)->iterators.find(layer - 1)->second; // move HEAD to the lower layer
+
+        layer--;
+      }
+    }
+    else {
+      updateTable[0] = (*topLayer)->begin();
+    }
+
+    head = updateTable[0];
+    ++head; // look at the next slot to check if it contains a duplicate
+
+    if (!m_cleanupIndex.empty() && head != m_skipList.front()->end() && (*head)->name == entry->name) {
+      (*head)->data = entry->data;
+
+      entry->data.reset();
+      m_freeEntries.push(entry);
+      return std::make_pair(*head, false);
+    }
+
+    size_t randomLayer = pickRandomLayer();
+
+    while (m_skipList.size() < randomLayer + 1) {
+      Layer* newLayer = new Layer();
+      m_skipList.push_back(newLayer);
+      updateTable[m_skipList.size() - 1] = newLayer->begin();
+    }
+
+    size_t layer = 0;
+    for (SkipList::iterator i = m_skipList.begin(); i != m_skipList.end() && layer <= randomLayer; ++i) {
+      if (updateTable[layer] == (*i)->end() && !insertInFront) {
+        (*i)->push_back(entry);
+        entry->iterators[layer] = --(*i)->end();
+      }
+      else if (updateTable[layer] == (*i)->end() && insertInFront) {
+        (*i)->push_front(entry);
+        entry->iterators[layer] = (*i)->begin();
+      }
+      else {
+        ++updateTable[layer]; // insert after
+        entry->iterators[layer] = (*i)->insert(updateTable[layer], entry);
+      }
+      layer++;
+    }
+
+    return std::make_pair(entry, true);
+  }
+
+  bool
+  evictItem()
+  {
+    if (m_cleanupIndex.empty())
+      return false;
+
+    Entry* entry = m_cleanupIndex.front();
+    m_cleanupIndex.pop_front();
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+
+    int layer = 0;
+    for (SkipList::iterator it = m_skipList.begin(); it != m_skipList.end();) {
+      std::map<int, Layer::iterator>::const_iterator i = entry->iterators.find(layer);
+      if (i == entry->iterators.end())
+        break;
+
+      (*it)->erase(i->second);
+
+      //remove layers that do not contain any elements (starting from the second layer)
+      if (layer != 0 && (*it)->empty()) {
+        delete *it;
+        it = m_skipList.erase(it);
+      }
+      else {
+        ++it;
+      }
+      layer++;
+    }
+
+    entry->iterators.clear();
+    entry->data.reset();
+    m_freeEntries.push(entry);
+    return true;
+  }
+
+  static size_t
+  pickRandomLayer()
+  {
+    int layer = -1;
+    int randomValue;
+
+    do {
+      layer++;
+      randomValue = rand() % 100 + 1;
+    } while ((randomValue < LIST_SKIPLIST_PROBABILITY) && (layer < LIST_SKIPLIST_MAX_LAYERS));
+
+    return static_cast<size_t>(layer);
+  }
+
+private:
+  SkipList m_skipList;
+  std::list<Entry*> m_cleanupIndex; // by arrival (FIFO)
+  size_t m_nMaxPackets;
+  std::queue<Entry*> m_freeEntries; // memory pool
+  boost::mutex m_mutex;
+};
+
+// Measures insert and find of the send buffer (Cs) filled up to its default size,
+// the same operations on the previous send buffer (ListSkipList) for a before/after comparison,
+// and on std::map as a reference ordered index.
+// Digests are computed up front, so that only the index is measured.
+class CsPerformance
+{
+public:
+  CsPerformance()
+  {
+    uint8_t content[1024] = {0};
+    uint8_t signatureValue[util::Sha256::DIGEST_SIZE] = {0};
+
+    for (uint64_t i = 0; i < N_ENTRIES; i++) {
+      shared_ptr<Data> data = make_shared<Data>(Name(PREFIX).appendSegment(i));
+      data->setContent(content, sizeof(content));
+      data->setSignature(DigestSha256());
+      data->setSignatureValue(makeBinaryBlock(tlv::SignatureValue, signatureValue, sizeof(signatureValue)));
+
+      const Block& wire = data->wireEncode();
+      m_digests.push_back(util::Sha256::computeDigest(wire.wire(), wire.size()));
+      m_segments.push_back(data);
+    }
+
+    // random exact-name lookups, Interest names are encoded before the clock starts
+    for (int i = 0; i < N_LOOKUPS; i++) {
+      uint64_t segment = rand() % N_ENTRIES;
+
+      Interest interest(Name(PREFIX).appendSegment(segment));
+      interest.getName().wireEncode();
+      m_interests.push_back(interest);
+
+      Interest fullNameInterest(Name(PREFIX).appendSegment(segment).appendImplicitSha256Digest(m_digests[segment]));
+      fullNameInterest.getName().wireEncode();
+      m_fullNameInterests.push_back(fullNameInterest);
+    }
+  }
+
+  void
+  measureCs()
+  {
+    Cs cs(N_ENTRIES);
+
+    time::steady_clock::TimePoint start = time::steady_clock::now();
+    for (size_t i = 0; i < m_segments.size(); i++) {
+      cs.insert(*m_segments[i], false, m_digests[i]);
+    }
+    report("Cs insert", m_segments.size(), time::steady_clock::now() - start);
+
+    size_t nHits = 0;
+    start = time::steady_clock::now();
+    for (size_t i = 0; i < m_interests.size(); i++) {
+      if (static_cast<bool>(cs.find(m_interests[i])))
+        nHits++;
+    }
+    report("Cs find", m_interests.size(), time::steady_clock::now() - start);
+
+    start = time::steady_clock::now();
+    for (size_t i = 0; i < m_fullNameInterests.size(); i++) {
+      if (static_cast<bool>(cs.find(m_fullNameInterests[i])))
+        nHits++;
+    }
+    report("Cs find (full name)", m_fullNameInterests.size(), time::steady_clock::now() - start);
+
+    if (nHits != m_interests.size() + m_fullNameInterests.size()) {
+      std::cout << "  " << m_interests.size() + m_fullNameInterests.size() - nHits
+                << " lookups missed" << std::endl;
+    }
+
+    // read throughput with several threads looking up at the same time
+    for (size_t nThreads = 2; nThreads <= boost::thread::hardware_concurrency(); nThreads *= 2) {
+      boost::thread_group threads;
+
+      start = time::steady_clock::now();
+      for (size_t i = 0; i < nThreads; i++) {
+        threads.create_thread(bind(&CsPerformance::findAll, this, std::ref(cs), i));
+      }
+      threads.join_all();
+
+      report("Cs find, " + std::to_string(nThreads) + " threads",
+             nThreads * m_interests.size(), time::steady_clock::now() - start);
+    }
+
+    // the same segments as one ADU, inserted and retired at once
+    Cs batchCs(N_ENTRIES);
+
+    start = time::steady_clock::now();
+    batchCs.insertBatch(m_segments, m_digests);
+    report("Cs insertBatch", m_segments.size(), time::steady_clock::now() - start);
+
+    start = time::steady_clock::now();
+    size_t nErased = batchCs.erasePrefix(Name(PREFIX));
+    report("Cs erasePrefix", nErased, time::steady_clock::now() - start);
+  }
+
+  void
+  measureListSkipList()
+  {
+    ListSkipList cs(N_ENTRIES);
+
+    time::steady_clock::TimePoint start = time::steady_clock::now();
+    for (size_t i = 0; i < m_segments.size(); i++) {
+      cs.insert(*m_segments[i], m_digests[i]);
+    }
+    report("ListSkipList insert", m_segments.size(), time::steady_clock::now() - start);
+
+    size_t nHits = 0;
+    start = time::steady_clock::now();
+    for (size_t i = 0; i < m_interests.size(); i++) {
+      if (cs.find(m_interests[i]) != 0)
+        nHits++;
+    }
+    report("ListSkipList find", m_interests.size(), time::steady_clock::now() - start);
+
+    start = time::steady_clock::now();
+    for (size_t i = 0; i < m_fullNameInterests.size(); i++) {
+      if (cs.find(m_fullNameInterests[i]) != 0)
+        nHits++;
+    }
+    report("ListSkipList find (full name)", m_fullNameInterests.size(), time::steady_clock::now() - start);
+
+    if (nHits != m_interests.size() + m_fullNameInterests.size()) {
+      std::cout << "  " << m_interests.size() + m_fullNameInterests.size() - nHits
+                << " lookups missed" << std::endl;
+    }
+
+    for (size_t nThreads = 2; nThreads <= boost::thread::hardware_concurrency(); nThreads *= 2) {
+      boost::thread_group threads;
+
+      start = time::steady_clock::now();
+      for (size_t i = 0; i < nThreads; i++) {
+        threads.create_thread(bind(&CsPerformance::findAllInList, this, std::ref(cs), i));
+      }
+      threads.join_all();
+
+      report("ListSkipList find, " + std::to_string(nThreads) + " threads",
+             nThreads * m_interests.size(), time::steady_clock::now() - start);
+    }
+  }
+
+  void
+  measureMap()
+  {
+    std::map<Name, shared_ptr<const Data>> index;
+
+    time::steady_clock::TimePoint start = time::steady_clock::now();
+    for (size_t i = 0; i < m_segments.size(); i++) {
+      index.insert(std::make_pair(m_segments[i]->getName(), m_segments[i]));
+    }
+    report("std::map insert", m_segments.size(), time::steady_clock::now() - start);
+
+    size_t nHits = 0;
+    start = time::steady_clock::now();
+    for (size_t i = 0; i < m_interests.size(); i++) {
+      std::map<Name, shared_ptr<const Data>>::const_iterator it = index.lower_bound(m_interests[i].getName());
+      if (it != index.end() && m_interests[i].getName().isPrefixOf(it->first))
+        nHits++;
+    }
+    report("std::map find", m_interests.size(), time::steady_clock::now() - start);
+  }
+
+private:
+  void
+  findAll(Cs& cs, size_t offset)
+  {
+    // every thread starts at a different place to avoid walking in lockstep
+    for (size_t i = 0; i < m_interests.size(); i++) {
+      cs.find(m_interests[(i + offset * 7919) % m_interests.size()]);
+    }
+  }
+
+  void
+  findAllInList(ListSkipList& cs, size_t offset)
+  {
+    for (size_t i = 0; i < m_interests.size(); i++) {
+      cs.find(m_interests[(i + offset * 7919) % m_interests.size()]);
+    }
+  }
+
+  void
+  report(const std::string& title, size_t nOperations, time::steady_clock::Duration duration)
+  {
+    double nanoseconds = static_cast<double>(time::duration_cast<time::nanoseconds>(duration).count());
+
+    std::cout << title << ": "
+              << nanoseconds / nOperations << " ns/op, "
+              << nOperations / nanoseconds * 1000000000 << " op/s" << std::endl;
+  }
+
+private:
+  std::vector<shared_ptr<Data>> m_segments;
+  std::vector<ConstBufferPtr> m_digests;
+  std::vector<Interest> m_interests;
+  std::vector<Interest> m_fullNameInterests;
+};
+
+int
+main(int argc, char** argv)
+{
+  CsPerformance performance;
+
+  std::cout << N_ENTRIES << " entries, " << N_LOOKUPS << " lookups" << std::endl;
+
+  performance.measureCs();
+  performance.measureListSkipList();
+  performance.measureMap();
+
+  return 0;
+}
+
+} // namespace examples
+} // namespace ndn
+
+int
+main(int argc, char** argv)
+{
+  return ndn::examples::main(argc, argv);
+}
@@ -0,0 +1,141 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+// correct way to include Consumer/Producer API headers
+//#include <Consumer-Producer-API/sha256-batch.hpp>
+#include "context-default-values.hpp"
+#include "sha256-batch.hpp"
+
+#include <ndn-cxx/util/sha256.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+#include <iostream>
+
+// Enclosing code in ndn simplifies coding (can also use `using namespace ndn`)
+namespace ndn {
+// Additional nested namespace could be used to prevent/limit name contentions
+namespace examples {
+
+#define CONTENT_LENGTH 16 * 1024 * 1024
+#define N_ROUNDS 10
+
+// Compares the per-packet digest path (util::Sha256) with every batch kernel
+// supported by this CPU on segments of the default Data packet size.
+class DigestPerformance
+{
+public:
+  DigestPerformance()
+    : m_content(CONTENT_LENGTH)
+  {
+    for (size_t i = 0; i < m_content.size(); i++) {
+      m_content[i] = static_cast<uint8_t>(rand());
+    }
+  }
+
+  void
+  measurePerPacket()
+  {
+    time::steady_clock::TimePoint start = time::steady_clock::now();
+
+    for (int round = 0; round < N_ROUNDS; round++) {
+      for (size_t offset = 0; offset < m_content.size(); offset += DEFAULT_DATA_PACKET_SIZE) {
+        util::Sha256::computeDigest(&m_content[offset], getSegmentSize(offset));
+      }
+    }
+
+    report("per-packet util::Sha256", time::steady_clock::now() - start);
+  }
+
+  void
+  measureBatch(Sha256Batch::Kernel kernel)
+  {
+    Sha256Batch batch(kernel);
+    time::steady_clock::TimePoint start = time::steady_clock::now();
+
+    for (int round = 0; round < N_ROUNDS; round++) {
+      for (size_t offset = 0; offset < m_content.size(); offset += DEFAULT_DATA_PACKET_SIZE) {
+        batch.add(&m_content[offset], getSegmentSize(offset));
+
+        // feed the kernel the way the producer does: one manifest worth of segments at a time
+        if (batch.size() == BATCH_SIZE) {
+          batch.compute();
+        }
+      }
+      batch.compute();
+    }
+
+    report(std::string("batch ") + Sha256Batch::getKernelName(kernel), time::steady_clock::now() - start);
+  }
+
+private:
+  size_t
+  getSegmentSize(size_t offset) const
+  {
+    return std::min<size_t>(DEFAULT_DATA_PACKET_SIZE, m_content.size() - offset);
+  }
+
+  void
+  report(const std::string& title, time::steady_clock::Duration duration)
+  {
+    double seconds = time::duration_cast<time::microseconds>(duration).count() / 1000000.0;
+    double nSegments = static_cast<double>(N_ROUNDS) * (CONTENT_LENGTH / DEFAULT_DATA_PACKET_SIZE);
+
+    std::cout << title << ": "
+              << (static_cast<double>(N_ROUNDS) * CONTENT_LENGTH) / seconds / 1000000 << " MB/s, "
+              << nSegments / seconds << " segments/s" << std::endl;
+  }
+
+private:
+  static const size_t BATCH_SIZE = 64;
+  std::vector<uint8_t> m_content;
+};
+
+int
+main(int argc, char** argv)
+{
+  DigestPerformance performance;
+
+  std::cout << "Detected kernel: " << Sha256Batch::getKernelName(Sha256Batch::detectKernel()) << std::endl;
+
+  performance.measurePerPacket();
+
+  const Sha256Batch::Kernel kernels[] = {Sha256Batch::KERNEL_SCALAR, Sha256Batch::KERNEL_SSE2,
+                                         Sha256Batch::KERNEL_AVX2, Sha256Batch::KERNEL_AVX512,
+                                         Sha256Batch::KERNEL_SHA_NI};
+
+  for (Sha256Batch::Kernel kernel : kernels) {
+    if (Sha256Batch::isSupported(kernel)) {
+      performance.measureBatch(kernel);
+    }
+  }
+
+  return 0;
+}
+
+} // namespace examples
+} // namespace ndn
+
+int
+main(int argc, char** argv)
+{
+  return ndn::examples::main(argc, argv);
+}
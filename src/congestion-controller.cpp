@@ -0,0 +1,269 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#include "congestion-controller.hpp"
+#include "context-default-values.hpp"
+
+#include <cmath>
+#include <limits>
+
+#define CUBIC_C 0.4     // scaling constant of the cubic function (Interests per second^3)
+#define CUBIC_BETA 0.7  // multiplicative decrease factor
+#define VEGAS_ALPHA 2.0 // fewer queued Interests than this: increase the window
+#define VEGAS_BETA 4.0  // more queued Interests than this: decrease the window
+#define VEGAS_GAMMA 1.0 // more queued Interests than this: leave slow start
+
+namespace ndn {
+
+static double
+toSeconds(time::nanoseconds duration)
+{
+  return static_cast<double>(duration.count()) / 1000000000;
+}
+
+CongestionController::CongestionController()
+  : m_windowSize(0)
+  , m_minWindowSize(DEFAULT_MIN_WINDOW_SIZE)
+  , m_maxWindowSize(DEFAULT_MAX_WINDOW_SIZE)
+{
+}
+
+CongestionController::~CongestionController()
+{
+}
+
+unique_ptr<CongestionController>
+CongestionController::create(int type)
+{
+  switch (type) {
+    case CONGESTION_CONTROL_AIMD:
+      return unique_ptr<CongestionController>(new AimdController());
+    case CONGESTION_CONTROL_CUBIC:
+      return unique_ptr<CongestionController>(new CubicController());
+    case CONGESTION_CONTROL_DELAY:
+      return unique_ptr<CongestionController>(new DelayBasedController());
+    default:
+      return unique_ptr<CongestionController>();
+  }
+}
+
+void
+CongestionController::setLimits(int minWindowSize, int maxWindowSize)
+{
+  m_minWindowSize = minWindowSize;
+  m_maxWindowSize = maxWindowSize;
+}
+
+int
+CongestionController::getWindowSize() const
+{
+  return static_cast<int>(m_windowSize);
+}
+
+void
+CongestionController::reset()
+{
+  m_windowSize = 0;
+}
+
+void
+CongestionController::afterFirstSegment(uint64_t finalBlockNumber)
+{
+  // the initial window
+  clampWindow();
+}
+
+void
+CongestionController::clampWindow()
+{
+  m_windowSize = std::max(m_windowSize, static_cast<double>(std::max(m_minWindowSize, 1)));
+  m_windowSize = std::min(m_windowSize, static_cast<double>(std::max(m_maxWindowSize, 1)));
+}
+
+void
+AimdController::afterFirstSegment(uint64_t finalBlockNumber)
+{
+  // in a next round try to transmit all Interests, except the first one,
+  // but put an upper boundary on it if there are too many
+  uint64_t maxWindowSize = static_cast<uint64_t>(std::max(m_maxWindowSize, 0));
+  m_windowSize = static_cast<double>(std::min(finalBlockNumber, maxWindowSize));
+}
+
+void
+AimdController::afterData(time::nanoseconds rtt)
+{
+  if (m_windowSize < m_maxWindowSize) // don't expand window above max level
+    m_windowSize++;
+}
+
+void
+AimdController::afterLoss()
+{
+  if (m_windowSize > m_minWindowSize) { // don't shrink window below minimum level
+    m_windowSize = std::floor(m_windowSize / 2); // cut in half
+    if (m_windowSize == 0)
+      m_windowSize++;
+  }
+}
+
+CubicController::CubicController()
+{
+  reset();
+}
+
+void
+CubicController::reset()
+{
+  CongestionController::reset();
+
+  m_slowStartThreshold = std::numeric_limits<double>::max();
+  m_lastMaxWindowSize = 0;
+  m_renoWindowSize = 0;
+  m_inflectionTime = 0;
+  m_isInEpoch = false;
+}
+
+void
+CubicController::afterData(time::nanoseconds rtt)
+{
+  if (m_windowSize < m_slowStartThreshold) {
+    m_windowSize++;
+    clampWindow();
+    return;
+  }
+
+  time::steady_clock::TimePoint now = time::steady_clock::now();
+
+  // congestion avoidance epoch starts with the first Data after a loss
+  if (!m_isInEpoch) {
+    m_isInEpoch = true;
+    m_epochStart = now;
+
+    if (m_windowSize < m_lastMaxWindowSize) {
+      m_inflectionTime = std::cbrt((m_lastMaxWindowSize - m_windowSize) / CUBIC_C);
+    }
+    else {
+      m_inflectionTime = 0;
+      m_lastMaxWindowSize = m_windowSize;
+    }
+    m_renoWindowSize = m_windowSize;
+  }
+
+  // the window one round-trip time ahead
+  double t = toSeconds(now - m_epochStart + rtt);
+  double target = m_lastMaxWindowSize + CUBIC_C * std::pow(t - m_inflectionTime, 3);
+
+  // never slower than Reno with the same decrease factor
+  m_renoWindowSize += 3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) / m_windowSize;
+  target = std::max(target, m_renoWindowSize);
+
+  target = std::min(target, 1.5 * m_windowSize);
+  if (target > m_windowSize)
+    m_windowSize += (target - m_windowSize) / m_windowSize;
+
+  clampWindow();
+}
+
+void
+CubicController::afterLoss()
+{
+  m_isInEpoch = false;
+
+  // fast convergence: release bandwidth when the window did not reach the previous maximum
+  if (m_windowSize < m_lastMaxWindowSize)
+    m_lastMaxWindowSize = m_windowSize * (1 + CUBIC_BETA) / 2;
+  else
+    m_lastMaxWindowSize = m_windowSize;
+
+  m_windowSize *= CUBIC_BETA;
+  clampWindow();
+  m_slowStartThreshold = m_windowSize;
+}
+
+DelayBasedController::DelayBasedController()
+{
+  reset();
+}
+
+void
+DelayBasedController::reset()
+{
+  CongestionController::reset();
+
+  m_slowStartThreshold = std::numeric_limits<double>::max();
+  m_baseRtt = time::nanoseconds::zero();
+  m_roundMinRtt = time::nanoseconds::zero();
+  m_nRoundSamples = 0;
+}
+
+void
+DelayBasedController::afterData(time::nanoseconds rtt)
+{
+  if (rtt > time::nanoseconds::zero()) {
+    if (m_baseRtt == time::nanoseconds::zero() || rtt < m_baseRtt)
+      m_baseRtt = rtt;
+    if (m_roundMinRtt == time::nanoseconds::zero() || rtt < m_roundMinRtt)
+      m_roundMinRtt = rtt;
+  }
+
+  bool isInSlowStart = m_windowSize < m_slowStartThreshold;
+  if (isInSlowStart)
+    m_windowSize++;
+
+  // the window is adjusted once per round, i.e. after a window of Data
+  m_nRoundSamples++;
+  if (m_nRoundSamples >= getWindowSize() && m_roundMinRtt > time::nanoseconds::zero()) {
+    // Interests in flight that sit in queues: window * (1 - baseRtt / rtt)
+    double nQueued = m_windowSize * toSeconds(m_roundMinRtt - m_baseRtt) / toSeconds(m_roundMinRtt);
+
+    if (isInSlowStart) {
+      if (nQueued > VEGAS_GAMMA) {
+        m_windowSize -= nQueued; // down to the window the path holds without queues
+        m_slowStartThreshold = m_windowSize;
+      }
+    }
+    else if (nQueued < VEGAS_ALPHA) {
+      m_windowSize++;
+    }
+    else if (nQueued > VEGAS_BETA) {
+      m_windowSize--;
+    }
+
+    m_nRoundSamples = 0;
+    m_roundMinRtt = time::nanoseconds::zero();
+  }
+
+  clampWindow();
+}
+
+void
+DelayBasedController::afterLoss()
+{
+  m_windowSize /= 2;
+  clampWindow();
+  m_slowStartThreshold = m_windowSize;
+
+  m_nRoundSamples = 0;
+  m_roundMinRtt = time::nanoseconds::zero();
+}
+
+} // namespace ndn
@@ -0,0 +1,177 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#ifndef CONGESTION_CONTROLLER_HPP
+#define CONGESTION_CONTROLLER_HPP
+
+#include "common.hpp"
+
+namespace ndn {
+
+/** \brief represents a congestion control algorithm of a data retrieval protocol
+ *
+ *  The controller owns the congestion window (the number of Interests that may be in flight)
+ *  and adjusts it when Data arrives or an Interest is lost. The protocol reads the window
+ *  back with getWindowSize() after every event.
+ */
+class CongestionController : noncopyable
+{
+public:
+  virtual
+  ~CongestionController();
+
+  /** \brief creates a built-in controller
+   *  \param type one of CONGESTION_CONTROL_* values
+   *  \return{ the controller, or null if the type is not known }
+   */
+  static unique_ptr<CongestionController>
+  create(int type);
+
+  /** \brief sets the bounds of the window (MIN_WINDOW_SIZE and MAX_WINDOW_SIZE)
+   */
+  void
+  setLimits(int minWindowSize, int maxWindowSize);
+
+  /** \brief returns the current window (in Interests)
+   */
+  int
+  getWindowSize() const;
+
+  /** \brief forgets the state, the window becomes empty
+   */
+  virtual void
+  reset();
+
+  /** \brief the first segment of an ADU arrived
+   *  \param finalBlockNumber the number of the last segment, if it is known
+   */
+  virtual void
+  afterFirstSegment(uint64_t finalBlockNumber);
+
+  /** \brief a segment arrived and was verified
+   *  \param rtt the round-trip time of the segment, zero if it was not measured
+   */
+  virtual void
+  afterData(time::nanoseconds rtt) = 0;
+
+  /** \brief an Interest timed out or was negatively acknowledged
+   */
+  virtual void
+  afterLoss() = 0;
+
+protected:
+  CongestionController();
+
+  /** \brief keeps the window within the limits, and at least one Interest
+   */
+  void
+  clampWindow();
+
+protected:
+  double m_windowSize;
+  int m_minWindowSize;
+  int m_maxWindowSize;
+};
+
+/** \brief additive increase, multiplicative decrease
+ *
+ *  The window grows by one Interest per Data and is halved on every loss (but not when it is
+ *  already within the minimum). After the first segment, the window opens up to the number
+ *  of segments of the ADU.
+ */
+class AimdController : public CongestionController
+{
+public:
+  virtual void
+  afterFirstSegment(uint64_t finalBlockNumber);
+
+  virtual void
+  afterData(time::nanoseconds rtt);
+
+  virtual void
+  afterLoss();
+};
+
+/** \brief CUBIC: the window grows as a cubic function of the time since the last loss
+ *
+ *  The window is increased quickly while it is far below the size at the last loss, carefully
+ *  around that size, and quickly again after it is passed, which uses long fat paths better
+ *  than linear growth. Below the slow start threshold the window grows by one per Data.
+ *
+ *  Reference: RFC 8312 "CUBIC for Fast Long-Distance Networks"
+ */
+class CubicController : public CongestionController
+{
+public:
+  CubicController();
+
+  virtual void
+  reset();
+
+  virtual void
+  afterData(time::nanoseconds rtt);
+
+  virtual void
+  afterLoss();
+
+private:
+  double m_slowStartThreshold;
+  double m_lastMaxWindowSize;  // W_max, the window at the last loss
+  double m_renoWindowSize;     // W_est, the window Reno would have
+  double m_inflectionTime;     // K, seconds from the epoch start to reach W_max
+  time::steady_clock::TimePoint m_epochStart;
+  bool m_isInEpoch;
+};
+
+/** \brief delay-based congestion avoidance (Vegas)
+ *
+ *  The controller compares the lowest round-trip time seen so far (the path without queues)
+ *  with the lowest round-trip time in the last round, and estimates how many Interests
+ *  sit in the queues of the path. The window grows while fewer than alpha are queued and
+ *  shrinks when more than beta are, so the queues stay short.
+ *
+ *  Reference: "TCP Vegas: End to End Congestion Avoidance on a Global Internet" by L.Brakmo et al.
+ */
+class DelayBasedController : public CongestionController
+{
+public:
+  DelayBasedController();
+
+  virtual void
+  reset();
+
+  virtual void
+  afterData(time::nanoseconds rtt);
+
+  virtual void
+  afterLoss();
+
+private:
+  double m_slowStartThreshold;
+  time::nanoseconds m_baseRtt;     // lowest round-trip time ever, zero if none
+  time::nanoseconds m_roundMinRtt; // lowest round-trip time in the current round, zero if none
+  int m_nRoundSamples;             // Data received in the current round
+};
+
+} // namespace ndn
+
+#endif // CONGESTION_CONTROLLER_HPP
@@ -32,9 +32,12 @@ Consumer::Consumer(Name prefix, int protocol)
   , m_minWindowSize(DEFAULT_MIN_WINDOW_SIZE)
   , m_maxWindowSize(DEFAULT_MAX_WINDOW_SIZE)
   , m_currentWindowSize(-1)
+  , m_congestionControl(DEFAULT_CONGESTION_CONTROL)
   , m_nMaxRetransmissions(CONSUMER_MAX_RETRANSMISSIONS)
   , m_nMaxExcludedDigests(DEFAULT_MAX_EXCLUDED_DIGESTS)
   , m_isAsync(false)
+  , m_contentBuffer(0)
+  , m_contentBufferSize(0)
   , m_minSuffixComponents(DEFAULT_MIN_SUFFIX_COMP)
   , m_maxSuffixComponents(DEFAULT_MAX_SUFFIX_COMP)
   , m_childSelector(0)
@@ -164,6 +167,15 @@ Consumer::setContextOption(int optionName, int optionValue)
       m_currentWindowSize = optionValue;
       return OPTION_VALUE_SET;
 
+    case CONGESTION_CONTROL:
+      if (optionValue >= CONGESTION_CONTROL_AIMD && optionValue <= CONGESTION_CONTROL_DELAY) {
+        m_congestionControl = optionValue;
+        return OPTION_VALUE_SET;
+      }
+      else {
+        return OPTION_VALUE_NOT_SET;
+      }
+
     case RCV_BUF_SIZE:
       m_receiveBufferSize = optionValue;
       return OPTION_VALUE_SET;
@@ -502,6 +514,10 @@ Consumer::getContextOption(int optionName, int& optionValue)
       optionValue = m_currentWindowSize;
       return OPTION_FOUND;
 
+    case CONGESTION_CONTROL:
+      optionValue = m_congestionControl;
+      return OPTION_FOUND;
+
     case RCV_BUF_SIZE:
       optionValue = m_receiveBufferSize;
       return OPTION_FOUND;
@@ -763,4 +779,18 @@ Consumer::consumeAll()
   face->processEvents();
 }
 
+void
+Consumer::setContentBuffer(uint8_t* buffer, size_t bufferSize)
+{
+  m_contentBuffer = buffer;
+  m_contentBufferSize = (buffer == 0) ? 0 : bufferSize;
+}
+
+void
+Consumer::getContentBuffer(uint8_t*& buffer, size_t& bufferSize) const
+{
+  buffer = m_contentBuffer;
+  bufferSize = m_contentBufferSize;
+}
+
 } //namespace ndn
@@ -91,6 +91,18 @@ public:
   static void
   consumeAll();
 
+  /**
+   * @brief Makes RDR reassemble Application Data Units (ADU) directly in the buffer of the application.
+   * The buffer must stay valid until the ADU is passed to CONTENT_RETRIEVED, which then points into it.
+   * An ADU larger than bufferSize is reassembled in an internal buffer instead.
+   * Passing a null buffer switches back to the internal buffer.
+   */
+  void
+  setContentBuffer(uint8_t* buffer, size_t bufferSize);
+
+  void
+  getContentBuffer(uint8_t*& buffer, size_t& bufferSize) const;
+
   /*
    * Context option setters
    * Return OPTION_VALUE_SET if success; otherwise -- OPTION_VALUE_NOT_SET
@@ -216,6 +228,7 @@ private:
   int m_minWindowSize;
   int m_maxWindowSize;
   int m_currentWindowSize;
+  int m_congestionControl;
   int m_nMaxRetransmissions;
   int m_nMaxExcludedDigests;
   size_t m_sendBufferSize;
@@ -223,6 +236,9 @@ private:
 
   bool m_isAsync;
 
+  uint8_t* m_contentBuffer; // supplied by the application, may be null
+  size_t m_contentBufferSize;
+
   /// selectors
 
   int m_minSuffixComponents;
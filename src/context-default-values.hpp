@@ -44,6 +44,7 @@ const ndn::Name CLIENT_CONTROL("ndn:/localhost/nfd/strategy/client-control");
 
 // default values
 #define DEFAULT_INTEREST_LIFETIME_API 200 // milliseconds
+#define DEFAULT_RDR_INTEREST_LIFETIME 4000 // milliseconds, RDR retransmits on its RTO timers before that
 #define DEFAULT_DATA_FRESHNESS 100000 // milliseconds ~= 100 seconds
 #define DEFAULT_DATA_PACKET_SIZE 2048 // bytes
 #define DEFAULT_INTEREST_SCOPE 2
@@ -51,12 +52,22 @@ const ndn::Name CLIENT_CONTROL("ndn:/localhost/nfd/strategy/client-control");
 #define DEFAULT_MAX_SUFFIX_COMP -1
 #define DEFAULT_PRODUCER_RCV_BUFFER_SIZE 1000 // of Interests
 #define DEFAULT_PRODUCER_SND_BUFFER_SIZE 1000 // of Data
+#define DEFAULT_PRODUCER_SND_BUFFER_SHARDS 16 // locks of the send buffer
+#define DEFAULT_PRODUCER_SND_BUFFER_POLICY CS_POLICY_FIFO
+#define DEFAULT_PRODUCER_SND_BUFFER_EXPIRY_INTERVAL 0 // milliseconds (disabled)
+#define DEFAULT_PRODUCER_SND_BUFFER_SNAPSHOT_INTERVAL 0  // milliseconds (only on destruction)
+#define DEFAULT_PRODUCER_RCV_BATCH_SIZE 64    // of Interests
+#define DEFAULT_PRODUCER_PROCESSING_THREADS 1 // of threads
+#define DEFAULT_PRODUCER_ENCODING_BATCH 64    // of Data segments
+#define DEFAULT_PRODUCER_PIT_SIZE 1000        // of Interests
+#define DEFAULT_PRODUCER_MAX_QUEUEING_DELAY 0 // milliseconds (disabled)
 #define DEFAULT_KEY_LOCATOR_SIZE 256          // of bytes
 #define DEFAULT_SAFETY_OFFSET 10              // of bytes
 #define DEFAULT_MIN_WINDOW_SIZE 4             // of Interests
 #define DEFAULT_MAX_WINDOW_SIZE 64            // of Interests
 #define DEFAULT_DIGEST_SIZE 32                // of bytes
-#define DEFAULT_FAST_RETX_CONDITION 3         // of out-of-order segments
+#define DEFAULT_REORDERING_WINDOW_FRACTION 4  // of the minimum RTT
+#define DEFAULT_CONGESTION_CONTROL CONGESTION_CONTROL_AIMD
 
 // maximum allowed values
 #define CONSUMER_MIN_RETRANSMISSIONS 0
@@ -84,6 +95,23 @@ const ndn::Name CLIENT_CONTROL("ndn:/localhost/nfd/strategy/client-control");
 #define LEFTMOST_CHILD 0
 #define RIGHTMOST_CHILD 1
 
+// distribution of Interests between producer processing threads
+#define SHARD_BY_ADU 0  // all segments of an ADU are processed by the same thread, in order
+#define SHARD_BY_NAME 1 // every Interest name is hashed separately
+
+// replacement policies of the producer send buffer
+#define CS_POLICY_FIFO 0              // the oldest packet is evicted first
+#define CS_POLICY_LRU 1               // least recently used
+#define CS_POLICY_LFU 2               // least frequently used, with aging
+#define CS_POLICY_TINY_LFU 3          // least frequently requested name among least recently used
+#define CS_POLICY_STALE_FIRST 4       // the packet that becomes stale first
+#define CS_POLICY_UNSOLICITED_FIRST 5 // unsolicited packets first, then FIFO
+
+// congestion control algorithms of the consumer data retrieval protocols
+#define CONGESTION_CONTROL_AIMD 0  // additive increase, multiplicative decrease
+#define CONGESTION_CONTROL_CUBIC 1 // cubic window growth (RFC 8312)
+#define CONGESTION_CONTROL_DELAY 2 // delay-based (Vegas)
+
 #define SHA_256 1
 #define RSA_256 2
 
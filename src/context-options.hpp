@@ -51,6 +51,26 @@
 #define INFOMAX_ROOT 24            // TreeNode
 #define INFOMAX_PRIORITY 25        // int
 #define INFOMAX_UPDATE_INTERVAL 26 // int (milliseconds)
+#define PROCESSING_THREADS 27      // int
+#define INTEREST_SHARDING 28       // int
+#define SIGNING_THREADS 29         // int
+#define MANIFEST_TREE 30           // bool
+#define PENDING_INTERESTS 31       // bool
+#define PENDING_INTERESTS_SIZE 32  // int
+#define MAX_QUEUEING_DELAY 33      // int (milliseconds)
+#define SND_BUF_POLICY 34          // int
+#define SND_BUF_HITS 35            // size_t
+#define SND_BUF_MISSES 36          // size_t
+#define SND_BUF_EVICTIONS 37       // size_t
+#define SND_BUF_BYTE_LIMIT 38      // size_t (bytes, 0 means no limit)
+#define SND_BUF_BYTES 39           // size_t (bytes)
+#define SND_BUF_EXPIRY_INTERVAL 40 // int (milliseconds, 0 disables removal of stale Data)
+#define SND_BUF_EXPIRATIONS 41     // size_t
+#define SND_BUF_SNAPSHOT_INTERVAL 42 // int (milliseconds, 0 saves the snapshot only on destruction)
+#define SND_BUF_DISK_BYTE_LIMIT 43 // size_t (bytes, 0 means no limit)
+#define SND_BUF_DISK_BYTES 44      // size_t (bytes)
+#define SND_BUF_DISK_HITS 45       // size_t
+#define CONGESTION_CONTROL 46      // int
 
 // selectors
 #define MIN_SUFFIX_COMP_S 101 // int
@@ -0,0 +1,247 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#include "cs-disk-tier.hpp"
+
+#include <boost/thread/locks.hpp>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdio>
+
+namespace ndn {
+namespace cs {
+
+DiskTier::DiskTier()
+  : m_fd(-1)
+  , m_logSize(0)
+  , m_nMaxBytes(0)
+  , m_nHits(0)
+{
+}
+
+DiskTier::~DiskTier()
+{
+  close();
+}
+
+bool
+DiskTier::open(const std::string& path)
+{
+  close();
+
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    return false;
+
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  m_fd = fd;
+  m_path = path;
+  return true;
+}
+
+void
+DiskTier::close()
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+
+  if (m_fd < 0)
+    return;
+
+  ::close(m_fd);
+  std::remove(m_path.c_str());
+
+  m_fd = -1;
+  m_path.clear();
+  m_logSize = 0;
+  m_index.clear();
+}
+
+bool
+DiskTier::isOpen() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_fd >= 0;
+}
+
+std::string
+DiskTier::makeKey(const Name& name)
+{
+  const Block& nameWire = name.wireEncode();
+  return std::string(reinterpret_cast<const char*>(nameWire.value()), nameWire.value_size());
+}
+
+bool
+DiskTier::insert(const Data& data, const time::steady_clock::TimePoint& staleTime)
+{
+  const Block& wire = data.wireEncode();
+  Record record = {0, wire.size(), staleTime};
+  int fd = -1;
+
+  // the space in the log is reserved under the lock, the packet is written without it
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+
+    if (m_fd < 0 || (m_nMaxBytes > 0 && m_logSize + wire.size() > m_nMaxBytes))
+      return false;
+
+    fd = m_fd;
+    record.offset = m_logSize;
+    m_logSize += wire.size();
+  }
+
+  size_t nWritten = 0;
+  while (nWritten < wire.size()) {
+    ssize_t result = ::pwrite(fd, wire.wire() + nWritten, wire.size() - nWritten, record.offset + nWritten);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      return false; // the reserved space stays unused
+
+    nWritten += result;
+  }
+
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  if (m_fd != fd)
+    return false; // closed or reopened meanwhile
+
+  m_index[makeKey(data.getName())] = record;
+  return true;
+}
+
+shared_ptr<const Data>
+DiskTier::find(const Interest& interest)
+{
+  const Name& name = interest.getName();
+
+  // the digest is not part of Data name, it is checked when the packet is decoded
+  bool hasDigest = !name.empty() && name.get(-1).isImplicitSha256Digest();
+  std::string key = hasDigest ? makeKey(name.getPrefix(-1)) : makeKey(name);
+
+  Record record;
+  int fd = -1;
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+
+    Index::const_iterator it = m_index.find(key);
+    if (m_fd < 0 || it == m_index.end())
+      return shared_ptr<const Data>();
+
+    fd = m_fd;
+    record = it->second;
+  }
+
+  shared_ptr<Buffer> buffer = make_shared<Buffer>(record.size);
+
+  size_t nRead = 0;
+  while (nRead < record.size) {
+    ssize_t result = ::pread(fd, buffer->data() + nRead, record.size - nRead, record.offset + nRead);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      return shared_ptr<const Data>();
+
+    nRead += result;
+  }
+
+  shared_ptr<Data> data;
+  try {
+    data = make_shared<Data>(Block(buffer));
+  }
+  catch (const tlv::Error&) {
+    return shared_ptr<const Data>();
+  }
+
+  if (!interest.matchesData(*data))
+    return shared_ptr<const Data>();
+
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  m_nHits++;
+  return data;
+}
+
+bool
+DiskTier::erase(const Name& name)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_index.erase(makeKey(name)) > 0;
+}
+
+size_t
+DiskTier::erasePrefix(const Name& prefix)
+{
+  std::string key = makeKey(prefix);
+
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+
+  // a name is under the prefix if the TLV value of the prefix starts its own
+  Index::iterator first = m_index.lower_bound(key);
+  Index::iterator last = first;
+  size_t nErased = 0;
+  while (last != m_index.end() && last->first.compare(0, key.size(), key) == 0) {
+    ++last;
+    nErased++;
+  }
+
+  m_index.erase(first, last);
+  return nErased;
+}
+
+void
+DiskTier::setByteLimit(size_t nMaxBytes)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  m_nMaxBytes = nMaxBytes;
+}
+
+size_t
+DiskTier::getByteLimit() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_nMaxBytes;
+}
+
+size_t
+DiskTier::getNBytes() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_logSize;
+}
+
+size_t
+DiskTier::size() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_index.size();
+}
+
+uint64_t
+DiskTier::getNHits() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_nHits;
+}
+
+} // namespace cs
+} // namespace ndn
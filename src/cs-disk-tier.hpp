@@ -0,0 +1,146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#ifndef CS_DISK_TIER_HPP
+#define CS_DISK_TIER_HPP
+
+#include "common.hpp"
+
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+#include <string>
+
+namespace ndn {
+namespace cs {
+
+/** \brief represents the second tier of Content Store on disk
+ *
+ *  Packets evicted from memory are appended to a log file as wire encodings; an index
+ *  in memory maps every Data name to the offset, size and stale time of its latest copy.
+ *  The index is ordered by the TLV value of the name, so the names under a prefix are
+ *  contiguous and can be erased together.
+ *  A lookup reads the wire encoding back with a single pread() and decodes it without
+ *  copying, so the packet is served without being produced or signed again.
+ *
+ *  Only Interests for exact Data names (or full names with implicit digest) are answered,
+ *  selectors are checked on the decoded packet. Replaced and erased packets are not reclaimed;
+ *  when the log reaches its byte limit, new packets are not stored anymore.
+ *  The tier is thread-safe.
+ */
+class DiskTier : noncopyable
+{
+public:
+  DiskTier();
+
+  ~DiskTier();
+
+  /** \brief creates an empty log file (an existing file is truncated)
+   *  \return{ false if the file cannot be created }
+   */
+  bool
+  open(const std::string& path);
+
+  /** \brief closes and removes the log file, and forgets all stored packets
+   *  Must not be called while other threads insert or look up packets.
+   */
+  void
+  close();
+
+  bool
+  isOpen() const;
+
+  /** \brief appends the packet to the log
+   *  \return{ false if the tier is closed, the log is full or the write failed }
+   */
+  bool
+  insert(const Data& data, const time::steady_clock::TimePoint& staleTime);
+
+  /** \brief reads the packet that satisfies the Interest from the log
+   *  \return{ the packet, if any; otherwise null }
+   */
+  shared_ptr<const Data>
+  find(const Interest& interest);
+
+  /** \brief forgets the packet with the Data name (without implicit digest)
+   *  \return{ false if no packet has the name }
+   */
+  bool
+  erase(const Name& name);
+
+  /** \brief forgets all packets under the prefix
+   *  \return{ number of forgotten packets }
+   */
+  size_t
+  erasePrefix(const Name& prefix);
+
+  /** \brief sets maximum size of the log (in bytes), 0 means no limit
+   */
+  void
+  setByteLimit(size_t nMaxBytes);
+
+  size_t
+  getByteLimit() const;
+
+  /** \brief returns the size of the log (in bytes)
+   */
+  size_t
+  getNBytes() const;
+
+  /** \brief returns the number of packets in the index
+   */
+  size_t
+  size() const;
+
+  /** \brief returns the number of lookups answered from the log
+   */
+  uint64_t
+  getNHits() const;
+
+private:
+  struct Record
+  {
+    uint64_t offset;
+    size_t size;
+    time::steady_clock::TimePoint staleTime;
+  };
+
+  // by the TLV value of Data name
+  typedef std::map<std::string, Record> Index;
+
+  static std::string
+  makeKey(const Name& name);
+
+private:
+  std::string m_path;
+  int m_fd;
+  uint64_t m_logSize;
+  size_t m_nMaxBytes;
+  uint64_t m_nHits;
+  Index m_index;
+  mutable boost::mutex m_mutex;
+};
+
+} // namespace cs
+} // namespace ndn
+
+#endif // CS_DISK_TIER_HPP
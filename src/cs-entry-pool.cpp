@@ -0,0 +1,89 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#include "cs-entry-pool.hpp"
+
+namespace ndn {
+namespace cs {
+
+const size_t EntryPool::MIN_CHUNK_SIZE;
+const size_t EntryPool::MAX_CHUNK_SIZE;
+
+EntryPool::EntryPool()
+  : m_nextChunkSize(MIN_CHUNK_SIZE)
+  , m_capacity(0)
+{
+}
+
+Entry*
+EntryPool::allocate()
+{
+  if (m_freeEntries.empty())
+    grow();
+
+  Entry* entry = m_freeEntries.back();
+  m_freeEntries.pop_back();
+
+  return entry;
+}
+
+void
+EntryPool::deallocate(Entry* entry)
+{
+  BOOST_ASSERT(m_freeEntries.size() < m_capacity);
+
+  m_freeEntries.push_back(entry);
+}
+
+void
+EntryPool::trim()
+{
+  if (size() > 0)
+    return;
+
+  m_freeEntries.clear();
+  m_freeEntries.shrink_to_fit();
+  m_chunks.clear();
+
+  m_nextChunkSize = MIN_CHUNK_SIZE;
+  m_capacity = 0;
+}
+
+void
+EntryPool::grow()
+{
+  size_t chunkSize = m_nextChunkSize;
+  m_nextChunkSize = std::min(m_nextChunkSize * 2, MAX_CHUNK_SIZE);
+
+  m_chunks.push_back(unique_ptr<Entry[]>(new Entry[chunkSize]));
+  Entry* chunk = m_chunks.back().get();
+
+  // the first entries of the chunk are handed out first
+  m_freeEntries.reserve(m_freeEntries.size() + chunkSize);
+  for (size_t i = chunkSize; i > 0; i--)
+    m_freeEntries.push_back(&chunk[i - 1]);
+
+  m_capacity += chunkSize;
+}
+
+} // namespace cs
+} // namespace ndn
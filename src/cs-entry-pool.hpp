@@ -0,0 +1,100 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#ifndef CS_ENTRY_POOL_HPP
+#define CS_ENTRY_POOL_HPP
+
+#include "common.hpp"
+#include "cs-entry.hpp"
+
+#include <vector>
+
+namespace ndn {
+namespace cs {
+
+/** \brief represents a memory pool of CS entries
+ *
+ *  Entries are allocated in contiguous chunks when the pool runs out of free entries,
+ *  every chunk twice as large as the previous one (up to a limit). Chunks are released
+ *  all at once, when the pool is destroyed or trimmed while no entry is in use.
+ *  The pool is not thread-safe.
+ */
+class EntryPool : noncopyable
+{
+public:
+  EntryPool();
+
+  /** \brief takes a free entry, growing the pool if there is none
+   */
+  Entry*
+  allocate();
+
+  /** \brief returns a released entry (see Entry::release()) to the pool
+   */
+  void
+  deallocate(Entry* entry);
+
+  /** \brief releases all chunks if no entry is in use
+   */
+  void
+  trim();
+
+  /** \brief returns the number of entries taken from the pool
+   */
+  size_t
+  size() const;
+
+  /** \brief returns the number of entries allocated by the pool (in use and free)
+   */
+  size_t
+  getCapacity() const;
+
+private:
+  void
+  grow();
+
+private:
+  static const size_t MIN_CHUNK_SIZE = 32;   // of entries
+  static const size_t MAX_CHUNK_SIZE = 4096; // of entries
+
+  std::vector<unique_ptr<Entry[]>> m_chunks;
+  std::vector<Entry*> m_freeEntries;
+  size_t m_nextChunkSize;
+  size_t m_capacity;
+};
+
+inline size_t
+EntryPool::size() const
+{
+  return m_capacity - m_freeEntries.size();
+}
+
+inline size_t
+EntryPool::getCapacity() const
+{
+  return m_capacity;
+}
+
+} // namespace cs
+} // namespace ndn
+
+#endif // CS_ENTRY_POOL_HPP
@@ -29,11 +29,15 @@ namespace cs {
 void
 Entry::release()
 {
-  BOOST_ASSERT(m_layerIterators.empty());
-
   m_dataPacket.reset();
   m_digest.reset();
   m_nameWithDigest.clear();
+  m_nameWire.reset();
+
+  m_key = 0;
+  m_keySize = 0;
+  m_height = 0;
+  std::fill(m_next, m_next + SKIPLIST_MAX_LAYERS, static_cast<Entry*>(0));
 }
 
 void
@@ -46,19 +50,24 @@ Entry::setData(const Data& data, bool isUnsolicited)
   updateStaleTime();
 
   m_nameWithDigest = data.getName();
-  m_nameWithDigest.append(ndn::name::Component(getDigest()));
+  m_nameWithDigest.append(ndn::name::Component::fromImplicitSha256Digest(getDigest()));
+
+  updateKey();
 }
 
 void
 Entry::setData(const Data& data, bool isUnsolicited, const ndn::ConstBufferPtr& digest)
 {
+  m_isUnsolicited = isUnsolicited;
   m_dataPacket = data.shared_from_this();
   m_digest = digest;
 
   updateStaleTime();
 
   m_nameWithDigest = data.getName();
-  m_nameWithDigest.append(ndn::name::Component(getDigest()));
+  m_nameWithDigest.append(ndn::name::Component::fromImplicitSha256Digest(getDigest()));
+
+  updateKey();
 }
 
 void
@@ -79,20 +88,11 @@ Entry::getDigest() const
 }
 
 void
-Entry::setIterator(int layer, const Entry::LayerIterators::mapped_type& layerIterator)
-{
-  m_layerIterators[layer] = layerIterator;
-}
-
-void
-Entry::removeIterator(int layer)
-{
-  m_layerIterators.erase(layer);
-}
-
-void
-Entry::printIterators() const
+Entry::updateKey()
 {
+  m_nameWire = m_nameWithDigest.wireEncode();
+  m_key = m_nameWire.value();
+  m_keySize = m_nameWire.value_size();
 }
 
 } // namespace cs
@@ -24,18 +24,25 @@
 
 #include "common.hpp"
 
+#include <algorithm>
+
+#define SKIPLIST_MAX_LAYERS 16 // enough for 4^16 entries with p = 1/4
+
 namespace ndn {
 namespace cs {
 
 class Entry;
+class ExpiryWheel;
 
 /** \brief represents a CS entry
+ *
+ *  The entry is also a node of the Content Store skip list: it carries its tower of
+ *  forward pointers inline, and the name key that the skip list compares.
+ *  It is linked into the expiry wheel (see ExpiryWheel) by its stale time.
  */
 class Entry : noncopyable
 {
 public:
-  typedef std::map<int, std::list<Entry*>::iterator> LayerIterators;
-
   Entry();
 
   /** \brief releases reference counts on shared objects
@@ -73,6 +80,8 @@ public:
   setData(const Data& data, bool isUnsolicited);
 
   /** \brief changes the content of CS entry and modifies digest
+   *  The digest must be the implicit SHA-256 digest of the Data wire encoding;
+   *  it is taken as is and the packet is not hashed again.
    */
   void
   setData(const Data& data, bool isUnsolicited, const ndn::ConstBufferPtr& digest);
@@ -88,28 +97,44 @@ public:
   const ndn::ConstBufferPtr&
   getDigest() const;
 
-  /** \brief saves the iterator pointing to the CS entry on a specific layer of skip list
+  /** \brief returns the name key: TLV encoding of the name components (with digest).
+   *
+   *  Comparing keys with memcmp (shorter key first on a tie) gives the NDN canonical order,
+   *  and a name is a prefix of another name exactly when its key is a prefix of the other key.
    */
-  void
-  setIterator(int layer, const LayerIterators::mapped_type& layerIterator);
+  const uint8_t*
+  getKey() const;
+
+  size_t
+  getKeySize() const;
 
-  /** \brief removes the iterator pointing to the CS entry on a specific layer of skip list
+  /** \brief returns the next CS entry on a specific layer of skip list
    */
+  Entry*
+  getNext(size_t layer) const;
+
   void
-  removeIterator(int layer);
+  setNext(size_t layer, Entry* next);
 
-  /** \brief returns the table containing <layer, iterator> pairs.
+  /** \brief returns the number of skip list layers that contain the CS entry
    */
-  const LayerIterators&
-  getIterators() const;
+  size_t
+  getHeight() const;
+
+  void
+  setHeight(size_t height);
 
 private:
-  /** \brief prints <layer, iterator> pairs.
-   */
   void
-  printIterators() const;
+  updateKey();
 
 private:
+  // skip list node: everything the search touches comes first
+  const uint8_t* m_key;
+  size_t m_keySize;
+  size_t m_height;
+  Entry* m_next[SKIPLIST_MAX_LAYERS];
+
   time::steady_clock::TimePoint m_staleAt;
   shared_ptr<const Data> m_dataPacket;
 
@@ -118,11 +143,24 @@ private:
 
   mutable ndn::ConstBufferPtr m_digest;
 
-  LayerIterators m_layerIterators;
+  Block m_nameWire; // owns the memory m_key points to
+
+  // expiry wheel slot list, managed by ExpiryWheel
+  Entry* m_expiryNext;
+  Entry** m_expiryPrev; // the pointer that points to this entry, 0 if not in the wheel
+
+  friend class ExpiryWheel;
 };
 
 inline Entry::Entry()
+  : m_key(0)
+  , m_keySize(0)
+  , m_height(0)
+  , m_isUnsolicited(false)
+  , m_expiryNext(0)
+  , m_expiryPrev(0)
 {
+  std::fill(m_next, m_next + SKIPLIST_MAX_LAYERS, static_cast<Entry*>(0));
 }
 
 inline const Name&
@@ -149,10 +187,43 @@ Entry::getStaleTime() const
   return m_staleAt;
 }
 
-inline const Entry::LayerIterators&
-Entry::getIterators() const
+inline const uint8_t*
+Entry::getKey() const
+{
+  return m_key;
+}
+
+inline size_t
+Entry::getKeySize() const
+{
+  return m_keySize;
+}
+
+inline Entry*
+Entry::getNext(size_t layer) const
+{
+  BOOST_ASSERT(layer < SKIPLIST_MAX_LAYERS);
+  return m_next[layer];
+}
+
+inline void
+Entry::setNext(size_t layer, Entry* next)
+{
+  BOOST_ASSERT(layer < SKIPLIST_MAX_LAYERS);
+  m_next[layer] = next;
+}
+
+inline size_t
+Entry::getHeight() const
+{
+  return m_height;
+}
+
+inline void
+Entry::setHeight(size_t height)
 {
-  return m_layerIterators;
+  BOOST_ASSERT(height <= SKIPLIST_MAX_LAYERS);
+  m_height = height;
 }
 
 } // namespace cs
@@ -0,0 +1,120 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#include "cs-expiry-wheel.hpp"
+
+namespace ndn {
+namespace cs {
+
+const size_t ExpiryWheel::N_SLOTS;
+const int64_t ExpiryWheel::TICK_DURATION;
+
+ExpiryWheel::ExpiryWheel()
+  : m_slots(N_SLOTS, static_cast<Entry*>(0))
+  , m_origin(time::steady_clock::now())
+  , m_nextTick(0)
+  , m_size(0)
+{
+}
+
+uint64_t
+ExpiryWheel::toTick(const time::steady_clock::TimePoint& timePoint) const
+{
+  if (timePoint <= m_origin)
+    return 0;
+
+  int64_t elapsed = time::duration_cast<time::milliseconds>(timePoint - m_origin).count();
+  return static_cast<uint64_t>(elapsed / TICK_DURATION);
+}
+
+void
+ExpiryWheel::insert(Entry* entry)
+{
+  BOOST_ASSERT(entry->m_expiryPrev == 0);
+
+  // the entry is stale by the end of its tick; ticks that were visited are due next time
+  uint64_t tick = std::max(toTick(entry->getStaleTime()) + 1, m_nextTick);
+  Entry** head = &m_slots[tick & (N_SLOTS - 1)];
+
+  entry->m_expiryNext = *head;
+  entry->m_expiryPrev = head;
+  if (*head != 0)
+    (*head)->m_expiryPrev = &entry->m_expiryNext;
+  *head = entry;
+
+  m_size++;
+}
+
+void
+ExpiryWheel::erase(Entry* entry)
+{
+  if (entry->m_expiryPrev == 0)
+    return;
+
+  *entry->m_expiryPrev = entry->m_expiryNext;
+  if (entry->m_expiryNext != 0)
+    entry->m_expiryNext->m_expiryPrev = entry->m_expiryPrev;
+
+  entry->m_expiryNext = 0;
+  entry->m_expiryPrev = 0;
+
+  m_size--;
+}
+
+void
+ExpiryWheel::expire(const time::steady_clock::TimePoint& now, std::vector<Entry*>& expired)
+{
+  uint64_t nowTick = toTick(now);
+  if (nowTick < m_nextTick)
+    return;
+
+  // after a long pause one pass over the whole wheel is enough
+  uint64_t firstTick = m_nextTick;
+  if (nowTick - firstTick >= N_SLOTS)
+    firstTick = nowTick - N_SLOTS + 1;
+
+  for (uint64_t tick = firstTick; tick <= nowTick; tick++)
+    expireSlot(tick & (N_SLOTS - 1), now, expired);
+
+  m_nextTick = nowTick + 1;
+}
+
+void
+ExpiryWheel::expireSlot(size_t slot, const time::steady_clock::TimePoint& now, std::vector<Entry*>& expired)
+{
+  Entry* entry = m_slots[slot];
+
+  while (entry != 0) {
+    Entry* next = entry->m_expiryNext;
+
+    // entries of later rounds share the slot and stay
+    if (entry->getStaleTime() <= now) {
+      erase(entry);
+      expired.push_back(entry);
+    }
+
+    entry = next;
+  }
+}
+
+} // namespace cs
+} // namespace ndn
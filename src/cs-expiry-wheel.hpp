@@ -0,0 +1,97 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#ifndef CS_EXPIRY_WHEEL_HPP
+#define CS_EXPIRY_WHEEL_HPP
+
+#include "common.hpp"
+#include "cs-entry.hpp"
+
+#include <vector>
+
+namespace ndn {
+namespace cs {
+
+/** \brief represents a timer wheel that orders CS entries by their stale time
+ *
+ *  Every slot of the wheel covers one tick of time and holds an intrusive list of the
+ *  entries that become stale during that tick (or during the same tick of a later round).
+ *  Insertion and removal are O(1); expire() visits only the slots that passed since
+ *  the previous call, and every entry is looked at once per round of the wheel.
+ *  The wheel is not thread-safe.
+ *
+ *  Reference: "Hashed and Hierarchical Timing Wheels" by G.Varghese and T.Lauck
+ */
+class ExpiryWheel : noncopyable
+{
+public:
+  ExpiryWheel();
+
+  /** \brief schedules the entry according to its stale time
+   *  The entry must not be in the wheel.
+   */
+  void
+  insert(Entry* entry);
+
+  /** \brief removes the entry from the wheel, does nothing if it is not there
+   */
+  void
+  erase(Entry* entry);
+
+  /** \brief removes the entries that are stale at time now from the wheel
+   *  and appends them to expired
+   */
+  void
+  expire(const time::steady_clock::TimePoint& now, std::vector<Entry*>& expired);
+
+  /** \brief returns the number of entries in the wheel
+   */
+  size_t
+  size() const;
+
+private:
+  uint64_t
+  toTick(const time::steady_clock::TimePoint& timePoint) const;
+
+  void
+  expireSlot(size_t slot, const time::steady_clock::TimePoint& now, std::vector<Entry*>& expired);
+
+private:
+  static const size_t N_SLOTS = 512;        // power of two
+  static const int64_t TICK_DURATION = 100; // milliseconds, a round is about 51 seconds
+
+  std::vector<Entry*> m_slots; // heads of the entry lists
+  time::steady_clock::TimePoint m_origin;
+  uint64_t m_nextTick; // the first tick whose slot was not visited yet
+  size_t m_size;
+};
+
+inline size_t
+ExpiryWheel::size() const
+{
+  return m_size;
+}
+
+} // namespace cs
+} // namespace ndn
+
+#endif // CS_EXPIRY_WHEEL_HPP
@@ -0,0 +1,350 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#include "cs-policy.hpp"
+#include "context-default-values.hpp"
+
+#include <boost/functional/hash.hpp>
+
+namespace ndn {
+namespace cs {
+
+Policy::~Policy()
+{
+}
+
+unique_ptr<Policy>
+Policy::create(int type)
+{
+  switch (type) {
+    case CS_POLICY_FIFO:
+      return unique_ptr<Policy>(new FifoPolicy());
+    case CS_POLICY_LRU:
+      return unique_ptr<Policy>(new LruPolicy());
+    case CS_POLICY_LFU:
+      return unique_ptr<Policy>(new LfuPolicy());
+    case CS_POLICY_TINY_LFU:
+      return unique_ptr<Policy>(new TinyLfuPolicy());
+    case CS_POLICY_STALE_FIRST:
+      return unique_ptr<Policy>(new StaleFirstPolicy());
+    case CS_POLICY_UNSOLICITED_FIRST:
+      return unique_ptr<Policy>(new UnsolicitedFirstPolicy());
+    default:
+      return unique_ptr<Policy>();
+  }
+}
+
+void
+Policy::setLimit(size_t nMaxEntries)
+{
+}
+
+void
+FifoPolicy::afterInsert(Entry* entry)
+{
+  m_queue.push_back(entry);
+}
+
+void
+FifoPolicy::afterRefresh(Entry* entry)
+{
+}
+
+void
+FifoPolicy::beforeUse(Entry* entry)
+{
+}
+
+void
+FifoPolicy::beforeErase(Entry* entry)
+{
+  m_queue.get<byEntry>().erase(entry);
+}
+
+Entry*
+FifoPolicy::pickVictim()
+{
+  if (m_queue.empty())
+    return 0;
+
+  return m_queue.front();
+}
+
+void
+LruPolicy::afterRefresh(Entry* entry)
+{
+  moveToBack(entry);
+}
+
+void
+LruPolicy::beforeUse(Entry* entry)
+{
+  moveToBack(entry);
+}
+
+void
+LruPolicy::moveToBack(Entry* entry)
+{
+  EntryQueue::index<byEntry>::type::iterator it = m_queue.get<byEntry>().find(entry);
+  if (it != m_queue.get<byEntry>().end()) {
+    m_queue.relocate(m_queue.end(), m_queue.project<byArrival>(it));
+  }
+}
+
+LfuPolicy::LfuPolicy()
+  : m_age(0)
+  , m_nextSequence(0)
+{
+}
+
+void
+LfuPolicy::afterInsert(Entry* entry)
+{
+  Record record = {entry, m_age + 1, m_nextSequence++};
+  m_records.insert(record);
+}
+
+void
+LfuPolicy::afterRefresh(Entry* entry)
+{
+  use(entry);
+}
+
+void
+LfuPolicy::beforeUse(Entry* entry)
+{
+  use(entry);
+}
+
+void
+LfuPolicy::use(Entry* entry)
+{
+  RecordIndex::index<byEntry>::type::iterator it = m_records.get<byEntry>().find(entry);
+  if (it == m_records.get<byEntry>().end())
+    return;
+
+  // one more use on top of the current age
+  uint64_t priority = std::max(it->priority, m_age) + 1;
+  uint64_t sequence = m_nextSequence++;
+
+  m_records.get<byEntry>().modify(it, [=] (Record& record) {
+      record.priority = priority;
+      record.sequence = sequence;
+    });
+}
+
+void
+LfuPolicy::beforeErase(Entry* entry)
+{
+  m_records.get<byEntry>().erase(entry);
+}
+
+Entry*
+LfuPolicy::pickVictim()
+{
+  if (m_records.empty())
+    return 0;
+
+  const Record& victim = *m_records.get<byPriority>().begin();
+  m_age = victim.priority;
+
+  return victim.entry;
+}
+
+TinyLfuPolicy::TinyLfuPolicy()
+  : m_mask(0)
+  , m_nIncrements(0)
+  , m_sampleSize(0)
+{
+  setLimit(1);
+}
+
+void
+TinyLfuPolicy::setLimit(size_t nMaxEntries)
+{
+  // about one counter per entry in every row, and ten samples per entry between resets
+  size_t width = 16;
+  while (width < nMaxEntries)
+    width <<= 1;
+
+  m_counters.assign(N_ROWS * width, 0);
+  m_mask = width - 1;
+  m_nIncrements = 0;
+  m_sampleSize = 10 * std::max<size_t>(nMaxEntries, 1);
+}
+
+void
+TinyLfuPolicy::afterInsert(Entry* entry)
+{
+  LruPolicy::afterInsert(entry);
+  increment(entry);
+}
+
+void
+TinyLfuPolicy::beforeUse(Entry* entry)
+{
+  LruPolicy::beforeUse(entry);
+  increment(entry);
+}
+
+Entry*
+TinyLfuPolicy::pickVictim()
+{
+  Entry* victim = 0;
+  uint8_t victimFrequency = MAX_COUNT + 1;
+
+  size_t nCandidates = 0;
+  for (EntryQueue::iterator it = m_queue.begin(); it != m_queue.end() && nCandidates < N_CANDIDATES;
+       ++it, ++nCandidates) {
+    uint8_t frequency = estimate(*it);
+
+    if (frequency < victimFrequency) {
+      victim = *it;
+      victimFrequency = frequency;
+    }
+  }
+
+  return victim;
+}
+
+size_t
+TinyLfuPolicy::getCounterIndex(size_t row, size_t hash) const
+{
+  // a different hash for every row, derived from one hash of the name
+  size_t rowHash = hash;
+  boost::hash_combine(rowHash, row);
+
+  return row * (m_mask + 1) + (rowHash & m_mask);
+}
+
+void
+TinyLfuPolicy::increment(const Entry* entry)
+{
+  size_t hash = boost::hash_range(entry->getKey(), entry->getKey() + entry->getKeySize());
+
+  for (size_t row = 0; row < N_ROWS; row++) {
+    uint8_t& counter = m_counters[getCounterIndex(row, hash)];
+    if (counter < MAX_COUNT)
+      counter++;
+  }
+
+  // aging: halve all counters, so that old popularity fades
+  if (++m_nIncrements >= m_sampleSize) {
+    for (size_t i = 0; i < m_counters.size(); i++)
+      m_counters[i] >>= 1;
+
+    m_nIncrements /= 2;
+  }
+}
+
+uint8_t
+TinyLfuPolicy::estimate(const Entry* entry) const
+{
+  size_t hash = boost::hash_range(entry->getKey(), entry->getKey() + entry->getKeySize());
+
+  uint8_t frequency = MAX_COUNT;
+  for (size_t row = 0; row < N_ROWS; row++)
+    frequency = std::min(frequency, m_counters[getCounterIndex(row, hash)]);
+
+  return frequency;
+}
+
+void
+StaleFirstPolicy::afterInsert(Entry* entry)
+{
+  m_entries.insert(entry);
+}
+
+void
+StaleFirstPolicy::afterRefresh(Entry* entry)
+{
+  // the stale time has already changed: remove the entry by identity, not by order
+  m_entries.get<byEntry>().erase(entry);
+  m_entries.insert(entry);
+}
+
+void
+StaleFirstPolicy::beforeUse(Entry* entry)
+{
+}
+
+void
+StaleFirstPolicy::beforeErase(Entry* entry)
+{
+  m_entries.get<byEntry>().erase(entry);
+}
+
+Entry*
+StaleFirstPolicy::pickVictim()
+{
+  if (m_entries.empty())
+    return 0;
+
+  return *m_entries.get<byStaleness>().begin();
+}
+
+void
+UnsolicitedFirstPolicy::afterInsert(Entry* entry)
+{
+  if (entry->isUnsolicited())
+    m_unsolicited.push_back(entry);
+  else
+    m_solicited.push_back(entry);
+}
+
+void
+UnsolicitedFirstPolicy::afterRefresh(Entry* entry)
+{
+  // the duplicate could change the unsolicited flag
+  EntryQueue& from = entry->isUnsolicited() ? m_solicited : m_unsolicited;
+
+  if (from.get<byEntry>().erase(entry) > 0) {
+    afterInsert(entry);
+  }
+}
+
+void
+UnsolicitedFirstPolicy::beforeUse(Entry* entry)
+{
+}
+
+void
+UnsolicitedFirstPolicy::beforeErase(Entry* entry)
+{
+  if (m_unsolicited.get<byEntry>().erase(entry) == 0)
+    m_solicited.get<byEntry>().erase(entry);
+}
+
+Entry*
+UnsolicitedFirstPolicy::pickVictim()
+{
+  if (!m_unsolicited.empty())
+    return m_unsolicited.front();
+
+  if (!m_solicited.empty())
+    return m_solicited.front();
+
+  return 0;
+}
+
+} // namespace cs
+} // namespace ndn
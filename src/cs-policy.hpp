@@ -0,0 +1,322 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#ifndef CS_POLICY_HPP
+#define CS_POLICY_HPP
+
+#include "common.hpp"
+#include "cs-entry.hpp"
+
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/identity.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index_container.hpp>
+
+#include <vector>
+
+namespace ndn {
+namespace cs {
+
+/** \brief represents a replacement policy of Content Store
+ *
+ *  The policy keeps its own order of CS entries and picks the victim when the Content Store
+ *  is full. Every shard of Content Store has its own policy object, and all methods are
+ *  called with the shard lock held.
+ */
+class Policy : noncopyable
+{
+public:
+  virtual
+  ~Policy();
+
+  /** \brief creates a built-in policy
+   *  \param type one of CS_POLICY_* values
+   *  \return{ the policy, or null if the type is not known }
+   */
+  static unique_ptr<Policy>
+  create(int type);
+
+  /** \brief informs the policy about the maximum number of entries
+   */
+  virtual void
+  setLimit(size_t nMaxEntries);
+
+  /** \brief a new entry is placed into Content Store
+   */
+  virtual void
+  afterInsert(Entry* entry) = 0;
+
+  /** \brief the entry received a duplicate packet (its stale time and flags are updated)
+   */
+  virtual void
+  afterRefresh(Entry* entry) = 0;
+
+  /** \brief the entry satisfies an Interest
+   */
+  virtual void
+  beforeUse(Entry* entry) = 0;
+
+  /** \brief the entry is going to be removed from Content Store
+   */
+  virtual void
+  beforeErase(Entry* entry) = 0;
+
+  /** \brief returns the entry that should be evicted next
+   *  \return{ the victim, or 0 if the policy does not track any entry }
+   */
+  virtual Entry*
+  pickVictim() = 0;
+};
+
+// tags
+class byArrival;
+class byEntry;
+class byPriority;
+class byStaleness;
+
+typedef boost::multi_index_container<Entry*,
+                                     boost::multi_index::indexed_by<
+                                       boost::multi_index::sequenced<boost::multi_index::tag<byArrival>>,
+                                       boost::multi_index::hashed_unique<boost::multi_index::tag<byEntry>,
+                                                                         boost::multi_index::identity<Entry*>>>>
+  EntryQueue;
+
+/** \brief evicts entries in the order of arrival
+ */
+class FifoPolicy : public Policy
+{
+public:
+  virtual void
+  afterInsert(Entry* entry);
+
+  virtual void
+  afterRefresh(Entry* entry);
+
+  virtual void
+  beforeUse(Entry* entry);
+
+  virtual void
+  beforeErase(Entry* entry);
+
+  virtual Entry*
+  pickVictim();
+
+protected:
+  EntryQueue m_queue;
+};
+
+/** \brief evicts the least recently used entry
+ */
+class LruPolicy : public FifoPolicy
+{
+public:
+  virtual void
+  afterRefresh(Entry* entry);
+
+  virtual void
+  beforeUse(Entry* entry);
+
+protected:
+  void
+  moveToBack(Entry* entry);
+};
+
+/** \brief evicts the least frequently used entry, with dynamic aging
+ *
+ *  The priority of an entry is its number of uses plus the priority of the last victim
+ *  at the time of use, so that entries which were popular long ago eventually leave.
+ *
+ *  Reference: "Evaluating content management techniques for Web proxy caches" by M.Arlitt et al.
+ */
+class LfuPolicy : public Policy
+{
+public:
+  LfuPolicy();
+
+  virtual void
+  afterInsert(Entry* entry);
+
+  virtual void
+  afterRefresh(Entry* entry);
+
+  virtual void
+  beforeUse(Entry* entry);
+
+  virtual void
+  beforeErase(Entry* entry);
+
+  virtual Entry*
+  pickVictim();
+
+private:
+  struct Record
+  {
+    Entry* entry;
+    uint64_t priority;
+    uint64_t sequence; // breaks ties in the order of arrival
+  };
+
+  typedef boost::multi_index_container<Record,
+                                       boost::multi_index::indexed_by<
+                                         boost::multi_index::ordered_non_unique<
+                                           boost::multi_index::tag<byPriority>,
+                                           boost::multi_index::composite_key<
+                                             Record,
+                                             boost::multi_index::member<Record, uint64_t, &Record::priority>,
+                                             boost::multi_index::member<Record, uint64_t, &Record::sequence>>>,
+                                         boost::multi_index::hashed_unique<
+                                           boost::multi_index::tag<byEntry>,
+                                           boost::multi_index::member<Record, Entry*, &Record::entry>>>>
+    RecordIndex;
+
+  void
+  use(Entry* entry);
+
+private:
+  RecordIndex m_records;
+  uint64_t m_age; // priority of the last victim
+  uint64_t m_nextSequence;
+};
+
+/** \brief evicts a rarely requested entry among the least recently used ones
+ *
+ *  Request frequency is estimated by a count-min sketch that remembers names after their
+ *  entries are evicted, and is halved periodically to forget old popularity. The victim is
+ *  the entry with the lowest estimate among the few least recently used entries.
+ *
+ *  Reference: "TinyLFU: A Highly Efficient Cache Admission Policy" by G.Einziger et al.
+ */
+class TinyLfuPolicy : public LruPolicy
+{
+public:
+  TinyLfuPolicy();
+
+  virtual void
+  setLimit(size_t nMaxEntries);
+
+  virtual void
+  afterInsert(Entry* entry);
+
+  virtual void
+  beforeUse(Entry* entry);
+
+  virtual Entry*
+  pickVictim();
+
+private:
+  void
+  increment(const Entry* entry);
+
+  uint8_t
+  estimate(const Entry* entry) const;
+
+  size_t
+  getCounterIndex(size_t row, size_t hash) const;
+
+private:
+  static const size_t N_ROWS = 4;
+  static const size_t N_CANDIDATES = 8; // LRU entries considered for eviction
+  static const uint8_t MAX_COUNT = 15;
+
+  std::vector<uint8_t> m_counters; // N_ROWS rows of saturating counters
+  size_t m_mask;                   // width of a row minus one (the width is a power of two)
+  size_t m_nIncrements;
+  size_t m_sampleSize; // number of increments after which all counters are halved
+};
+
+/** \brief evicts the entry that becomes stale first
+ */
+class StaleFirstPolicy : public Policy
+{
+public:
+  virtual void
+  afterInsert(Entry* entry);
+
+  virtual void
+  afterRefresh(Entry* entry);
+
+  virtual void
+  beforeUse(Entry* entry);
+
+  virtual void
+  beforeErase(Entry* entry);
+
+  virtual Entry*
+  pickVictim();
+
+private:
+  class StalenessComparator
+  {
+  public:
+    bool
+    operator()(const Entry* entry1, const Entry* entry2) const
+    {
+      return entry1->getStaleTime() < entry2->getStaleTime();
+    }
+  };
+
+  typedef boost::multi_index_container<Entry*,
+                                       boost::multi_index::indexed_by<
+                                         boost::multi_index::ordered_non_unique<
+                                           boost::multi_index::tag<byStaleness>,
+                                           boost::multi_index::identity<Entry*>,
+                                           StalenessComparator>,
+                                         boost::multi_index::hashed_unique<
+                                           boost::multi_index::tag<byEntry>,
+                                           boost::multi_index::identity<Entry*>>>>
+    StalenessIndex;
+
+  StalenessIndex m_entries;
+};
+
+/** \brief evicts unsolicited entries first, then the others, each in the order of arrival
+ */
+class UnsolicitedFirstPolicy : public Policy
+{
+public:
+  virtual void
+  afterInsert(Entry* entry);
+
+  virtual void
+  afterRefresh(Entry* entry);
+
+  virtual void
+  beforeUse(Entry* entry);
+
+  virtual void
+  beforeErase(Entry* entry);
+
+  virtual Entry*
+  pickVictim();
+
+private:
+  EntryQueue m_unsolicited;
+  EntryQueue m_solicited;
+};
+
+} // namespace cs
+} // namespace ndn
+
+#endif // CS_POLICY_HPP
@@ -0,0 +1,181 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#include "cs-snapshot.hpp"
+#include "cs.hpp"
+#include "sha256-batch.hpp"
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 12       // magic(8) version(4)
+#define SNAPSHOT_INDEX_RECORD_SIZE 20 // offset(8) size(4) staleTime(8)
+#define SNAPSHOT_TRAILER_SIZE 24      // indexOffset(8) nRecords(8) magic(8)
+
+namespace ndn {
+namespace cs {
+
+static const char LOG_MAGIC[] = "NDNCSLOG";
+static const char INDEX_MAGIC[] = "NDNCSIDX";
+
+static void
+writeNumber(std::ostream& os, uint64_t value, size_t size)
+{
+  uint8_t buffer[8];
+  for (size_t i = 0; i < size; i++)
+    buffer[i] = static_cast<uint8_t>(value >> (8 * (size - 1 - i)));
+
+  os.write(reinterpret_cast<const char*>(buffer), size);
+}
+
+static uint64_t
+readNumber(const uint8_t* buffer, size_t size)
+{
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; i++)
+    value = (value << 8) | buffer[i];
+
+  return value;
+}
+
+bool
+Snapshot::save(const Cs& cs, const std::string& path)
+{
+  std::vector<shared_ptr<const Data>> packets;
+  std::vector<time::steady_clock::TimePoint> staleTimes;
+  cs.getPackets(packets, staleTimes);
+
+  std::string temporaryPath = path + ".tmp";
+  std::ofstream os(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+  if (!os.is_open())
+    return false;
+
+  os.write(LOG_MAGIC, 8);
+  writeNumber(os, SNAPSHOT_VERSION, 4);
+
+  std::vector<uint64_t> offsets;
+  offsets.reserve(packets.size());
+
+  uint64_t offset = SNAPSHOT_HEADER_SIZE;
+  for (size_t i = 0; i < packets.size(); i++) {
+    const Block& wire = packets[i]->wireEncode();
+    os.write(reinterpret_cast<const char*>(wire.wire()), wire.size());
+
+    offsets.push_back(offset);
+    offset += wire.size();
+  }
+
+  // stale times are kept on the steady clock, which does not survive a restart
+  time::steady_clock::TimePoint steadyNow = time::steady_clock::now();
+  time::system_clock::TimePoint systemNow = time::system_clock::now();
+
+  for (size_t i = 0; i < packets.size(); i++) {
+    time::system_clock::TimePoint staleTime = systemNow +
+      time::duration_cast<time::system_clock::Duration>(staleTimes[i] - steadyNow);
+
+    writeNumber(os, offsets[i], 8);
+    writeNumber(os, packets[i]->wireEncode().size(), 4);
+    writeNumber(os, static_cast<uint64_t>(time::toUnixTimestamp(staleTime).count()), 8);
+  }
+
+  writeNumber(os, offset, 8);
+  writeNumber(os, packets.size(), 8);
+  os.write(INDEX_MAGIC, 8);
+
+  os.close();
+  if (os.fail()) {
+    std::remove(temporaryPath.c_str());
+    return false;
+  }
+
+  return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+size_t
+Snapshot::load(Cs& cs, const std::string& path)
+{
+  boost::iostreams::mapped_file_source file;
+
+  try {
+    file.open(path);
+  }
+  catch (const std::ios_base::failure&) {
+    return 0;
+  }
+
+  if (!file.is_open() || file.size() < SNAPSHOT_HEADER_SIZE + SNAPSHOT_TRAILER_SIZE)
+    return 0;
+
+  const uint8_t* begin = reinterpret_cast<const uint8_t*>(file.data());
+  const uint8_t* trailer = begin + file.size() - SNAPSHOT_TRAILER_SIZE;
+
+  if (std::memcmp(begin, LOG_MAGIC, 8) != 0 || readNumber(begin + 8, 4) != SNAPSHOT_VERSION ||
+      std::memcmp(trailer + 16, INDEX_MAGIC, 8) != 0)
+    return 0;
+
+  uint64_t indexOffset = readNumber(trailer, 8);
+  uint64_t nRecords = readNumber(trailer + 8, 8);
+
+  if (indexOffset < SNAPSHOT_HEADER_SIZE || indexOffset > file.size() - SNAPSHOT_TRAILER_SIZE ||
+      nRecords != (file.size() - SNAPSHOT_TRAILER_SIZE - indexOffset) / SNAPSHOT_INDEX_RECORD_SIZE)
+    return 0;
+
+  time::milliseconds now = time::toUnixTimestamp(time::system_clock::now());
+
+  std::vector<shared_ptr<Data>> packets;
+  packets.reserve(nRecords);
+
+  for (uint64_t i = 0; i < nRecords; i++) {
+    const uint8_t* record = begin + indexOffset + i * SNAPSHOT_INDEX_RECORD_SIZE;
+    uint64_t offset = readNumber(record, 8);
+    uint64_t size = readNumber(record + 8, 4);
+    time::milliseconds staleTime(static_cast<int64_t>(readNumber(record + 12, 8)));
+
+    if (offset < SNAPSHOT_HEADER_SIZE || offset > indexOffset || size > indexOffset - offset)
+      continue;
+
+    // stale packets are served unless Content Store removes them, and the freshness
+    // period starts anew when the packet is inserted
+    if (cs.isExpiring() && staleTime <= now)
+      continue;
+
+    try {
+      packets.push_back(make_shared<Data>(Block(begin + offset, size)));
+    }
+    catch (const tlv::Error&) {
+      continue;
+    }
+  }
+
+  Sha256Batch implicitDigests;
+  for (size_t i = 0; i < packets.size(); i++)
+    implicitDigests.add(packets[i]->wireEncode());
+
+  return cs.insertBatch(packets, implicitDigests.compute());
+}
+
+} // namespace cs
+} // namespace ndn
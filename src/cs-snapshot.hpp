@@ -0,0 +1,72 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#ifndef CS_SNAPSHOT_HPP
+#define CS_SNAPSHOT_HPP
+
+#include "common.hpp"
+
+#include <string>
+
+namespace ndn {
+
+class Cs;
+
+namespace cs {
+
+/** \brief saves Content Store into a file and loads it back, e.g. across producer restarts
+ *
+ *  The file is a log of Data wire encodings, written back to back, followed by an index
+ *  (offset, size and stale time of every packet) and a trailer that locates the index:
+ *
+ *    header:  "NDNCSLOG" version(4)
+ *    log:     Data ... Data
+ *    index:   offset(8) size(4) staleTime(8) ...   (stale time in milliseconds since Unix epoch)
+ *    trailer: indexOffset(8) nRecords(8) "NDNCSIDX"
+ *
+ *  Integers are big-endian. A snapshot is written into a temporary file that replaces
+ *  the previous snapshot only when it is complete, so a crash leaves the old one intact.
+ *  Loading maps the file into memory and inserts all packets with one Cs::insertBatch() call;
+ *  packets that became stale while the producer was down are skipped only if Content Store
+ *  removes stale packets (see Cs::setExpiry), so both tiers follow the same rules.
+ */
+class Snapshot
+{
+public:
+  /** \brief writes all packets of Content Store into the file
+   *  \return{ false if the file cannot be written }
+   */
+  static bool
+  save(const Cs& cs, const std::string& path);
+
+  /** \brief inserts the packets from the file into Content Store
+   *  Packets that cannot be decoded are skipped.
+   *  \return{ number of inserted packets, 0 if the file is missing or malformed }
+   */
+  static size_t
+  load(Cs& cs, const std::string& path);
+};
+
+} // namespace cs
+} // namespace ndn
+
+#endif // CS_SNAPSHOT_HPP
@@ -20,212 +20,605 @@
  */
 
 #include "cs.hpp"
+#include "context-default-values.hpp"
 
 #include <ndn-cxx/util/sha256.hpp>
 
 #include <iostream>
 
-#define SKIPLIST_MAX_LAYERS 32
 #define SKIPLIST_PROBABILITY 25 // 25% (p = 1/4)
 
+// TLV of the implicit digest component that ends every key
+#define DIGEST_COMPONENT_SIZE (2 + ndn::util::Sha256::DIGEST_SIZE)
+
+// nodes of the two hash indexes (key, value, next pointer and cached hash)
+// and of the replacement policy (about four pointers)
+#define ENTRY_INDEX_OVERHEAD (2 * (sizeof(NameKey) + 3 * sizeof(void*)) + 4 * sizeof(void*))
+
 namespace ndn {
 
-Cs::Cs(int nMaxPackets)
-  : m_nMaxPackets(nMaxPackets)
+Cs::Shard::Shard()
+  : nLayers(1)
+  , policy(cs::Policy::create(CS_POLICY_FIFO))
+  , nPackets(0)
+  , nHits(0)
+  , nMisses(0)
+  , nEvictions(0)
+  , nExpirations(0)
+{
+}
+
+Cs::Cs(int nMaxPackets, size_t nShards)
+  : m_nMaxPackets(std::max(nMaxPackets, 1))
   , m_nPackets(0)
+  , m_nextVictimShard(0)
+  , m_nMaxBytes(0)
+  , m_nBytes(0)
+  , m_policyType(CS_POLICY_FIFO)
+  , m_isExpiring(false)
 {
-  SkipListLayer* zeroLayer = new SkipListLayer();
-  m_skipList.push_back(zeroLayer);
+  BOOST_ASSERT(nShards > 0);
+
+  for (size_t i = 0; i < nShards; i++)
+    m_shards.push_back(unique_ptr<Shard>(new Shard()));
 
-  for (size_t i = 0; i < m_nMaxPackets; i++)
-    m_freeCsEntries.push(new cs::Entry());
+  for (size_t i = 0; i < m_shards.size(); i++)
+    m_shards[i]->policy->setLimit(getShardShare());
 }
 
 Cs::~Cs()
 {
-  // evict all items from CS
-  while (evictItem())
-    ;
+  EvictionList evicted;
 
-  BOOST_ASSERT(m_freeCsEntries.size() == m_nMaxPackets);
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    Shard& shard = *m_shards[i];
 
-  while (!m_freeCsEntries.empty()) {
-    delete m_freeCsEntries.front();
-    m_freeCsEntries.pop();
+    // evict all items from the shard, the entry pool frees its chunks on destruction
+    while (evictItem(shard, evicted))
+      ;
+    evicted.clear();
+
+    BOOST_ASSERT(shard.pool.size() == 0);
   }
 }
 
 size_t
 Cs::size() const
 {
-  return m_nPackets; // size of the first layer in a skip list
+  return m_nPackets;
 }
 
 void
 Cs::setLimit(size_t nMaxPackets)
 {
-  size_t oldNMaxPackets = m_nMaxPackets;
-  m_nMaxPackets = nMaxPackets;
+  m_nMaxPackets = std::max<size_t>(nMaxPackets, 1);
+
+  EvictionList evicted;
+  enforceLimit(evicted);
+
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    Shard& shard = *m_shards[i];
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+
+    shard.policy->setLimit(getShardShare());
+
+    // entries are allocated on demand; the memory goes back only when nothing is stored
+    shard.pool.trim();
+  }
+
+  announceEvictions(evicted);
+}
+
+size_t
+Cs::getLimit() const
+{
+  return m_nMaxPackets;
+}
+
+Cs::Shard&
+Cs::getShard(const uint8_t* nameKey, size_t nameKeySize)
+{
+  return *m_shards[getShardIndex(nameKey, nameKeySize)];
+}
+
+size_t
+Cs::getShardIndex(const uint8_t* nameKey, size_t nameKeySize) const
+{
+  NameKey key = {nameKey, nameKeySize};
+  return NameKeyHash()(key) % m_shards.size();
+}
+
+size_t
+Cs::getShardShare() const
+{
+  return (m_nMaxPackets + m_shards.size() - 1) / m_shards.size();
+}
+
+bool
+Cs::isOverLimit() const
+{
+  // the last packet stays even if it alone is over the budget
+  return m_nPackets > m_nMaxPackets || (m_nMaxBytes > 0 && m_nBytes > m_nMaxBytes && m_nPackets > 1);
+}
+
+void
+Cs::enforceLimit(EvictionList& evicted)
+{
+  // the store is not empty while it is over the limit, so some shard always has a victim
+  while (isOverLimit()) {
+    Shard& shard = *m_shards[m_nextVictimShard++ % m_shards.size()];
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+
+    // other threads may have made room meanwhile
+    if (isOverLimit())
+      evictItem(shard, evicted);
+  }
+}
+
+void
+Cs::setByteLimit(size_t nMaxBytes)
+{
+  m_nMaxBytes = nMaxBytes;
+
+  EvictionList evicted;
+  enforceLimit(evicted);
+  announceEvictions(evicted);
+}
 
-  while (isFull()) {
-    if (!evictItem())
+size_t
+Cs::getByteLimit() const
+{
+  return m_nMaxBytes;
+}
+
+size_t
+Cs::getNBytes() const
+{
+  return m_nBytes;
+}
+
+void
+Cs::enforceByteLimit(Shard& shard, EvictionList& evicted)
+{
+  // the new packet stays, enforceLimit() takes the rest from the other shards
+  while (m_nMaxBytes > 0 && m_nBytes > m_nMaxBytes && shard.nPackets > 1) {
+    if (!evictItem(shard, evicted))
       break;
   }
+}
 
-  if (m_nMaxPackets >= oldNMaxPackets) {
-    for (size_t i = oldNMaxPackets; i < m_nMaxPackets; i++) {
-      m_freeCsEntries.push(new cs::Entry());
-    }
+size_t
+Cs::getEntrySize(const cs::Entry* entry)
+{
+  return entry->getData().wireEncode().size() + entry->getKeySize() + entry->getDigest()->size() +
+         sizeof(cs::Entry) + ENTRY_INDEX_OVERHEAD;
+}
+
+bool
+Cs::setPolicy(int policyType)
+{
+  if (!static_cast<bool>(cs::Policy::create(policyType)))
+    return false;
+
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    Shard& shard = *m_shards[i];
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+
+    unique_ptr<cs::Policy> policy = cs::Policy::create(policyType);
+    policy->setLimit(getShardShare());
+
+    // the new policy learns the stored packets in name order
+    for (cs::Entry* entry = shard.head.getNext(0); entry != 0; entry = entry->getNext(0))
+      policy->afterInsert(entry);
+
+    shard.policy = std::move(policy);
   }
-  else {
-    for (size_t i = oldNMaxPackets; i > m_nMaxPackets; i--) {
-      delete m_freeCsEntries.front();
-      m_freeCsEntries.pop();
-    }
+
+  m_policyType = policyType;
+  return true;
+}
+
+int
+Cs::getPolicy() const
+{
+  return m_policyType;
+}
+
+void
+Cs::setEvictionCallback(const EvictionCallback& onEviction)
+{
+  m_onEviction = onEviction;
+}
+
+uint64_t
+Cs::getNHits() const
+{
+  uint64_t nHits = 0;
+
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    boost::lock_guard<boost::mutex> lock(m_shards[i]->mutex);
+    nHits += m_shards[i]->nHits;
   }
+
+  return nHits;
+}
+
+uint64_t
+Cs::getNMisses() const
+{
+  uint64_t nMisses = 0;
+
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    boost::lock_guard<boost::mutex> lock(m_shards[i]->mutex);
+    nMisses += m_shards[i]->nMisses;
+  }
+
+  return nMisses;
+}
+
+uint64_t
+Cs::getNEvictions() const
+{
+  uint64_t nEvictions = 0;
+
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    boost::lock_guard<boost::mutex> lock(m_shards[i]->mutex);
+    nEvictions += m_shards[i]->nEvictions;
+  }
+
+  return nEvictions;
+}
+
+void
+Cs::setExpiry(bool isExpiring)
+{
+  // the flag is read under the lock of any one shard
+  std::vector<boost::unique_lock<boost::mutex>> locks;
+  locks.reserve(m_shards.size());
+
+  for (size_t i = 0; i < m_shards.size(); i++)
+    locks.push_back(boost::unique_lock<boost::mutex>(m_shards[i]->mutex));
+
+  m_isExpiring = isExpiring;
+}
+
+bool
+Cs::isExpiring() const
+{
+  return m_isExpiring;
+}
+
+uint64_t
+Cs::getNExpirations() const
+{
+  uint64_t nExpirations = 0;
+
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    boost::lock_guard<boost::mutex> lock(m_shards[i]->mutex);
+    nExpirations += m_shards[i]->nExpirations;
+  }
+
+  return nExpirations;
 }
 
 size_t
-Cs::getLimit() const
+Cs::removeExpired()
 {
-  return m_nMaxPackets;
+  EvictionList evicted;
+  size_t nExpired = 0;
+
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    boost::lock_guard<boost::mutex> lock(m_shards[i]->mutex);
+    nExpired += expireItems(*m_shards[i], evicted);
+  }
+
+  announceEvictions(evicted);
+  return nExpired;
+}
+
+size_t
+Cs::expireItems(Shard& shard, EvictionList& evicted)
+{
+  if (!m_isExpiring || shard.expiryWheel.size() == 0)
+    return 0;
+
+  std::vector<cs::Entry*> expired;
+  shard.expiryWheel.expire(time::steady_clock::now(), expired);
+
+  for (size_t i = 0; i < expired.size(); i++) {
+    shard.policy->beforeErase(expired[i]);
+    Eviction eviction = {expired[i]->getData().shared_from_this(), expired[i]->getStaleTime(), true};
+    evicted.push_back(eviction);
+    eraseFromSkipList(shard, expired[i]);
+  }
+
+  shard.nExpirations += expired.size();
+  return expired.size();
+}
+
+bool
+Cs::setDiskTier(const std::string& path)
+{
+  if (path.empty()) {
+    m_diskTier.close();
+    return true;
+  }
+
+  return m_diskTier.open(path);
+}
+
+cs::DiskTier&
+Cs::getDiskTier()
+{
+  return m_diskTier;
+}
+
+const cs::DiskTier&
+Cs::getDiskTier() const
+{
+  return m_diskTier;
+}
+
+int
+Cs::compareKeys(const uint8_t* key1, size_t keySize1, const uint8_t* key2, size_t keySize2)
+{
+  int result = std::memcmp(key1, key2, std::min(keySize1, keySize2));
+  if (result != 0)
+    return result;
+
+  // a proper prefix goes first
+  if (keySize1 < keySize2)
+    return -1;
+  if (keySize1 > keySize2)
+    return 1;
+
+  return 0;
+}
+
+int
+Cs::compareKeys(const cs::Entry* entry, const uint8_t* key, size_t keySize)
+{
+  return compareKeys(entry->getKey(), entry->getKeySize(), key, keySize);
 }
 
 //Reference: "Skip Lists: A Probabilistic Alternative to Balanced Trees" by W.Pugh
-std::pair<cs::Entry*, bool>
-Cs::insertToSkipList(const Data& data, bool isUnsolicited)
+cs::Entry*
+Cs::findPredecessors(Shard& shard, const uint8_t* key, size_t keySize, cs::Entry** predecessors)
 {
-  BOOST_ASSERT(m_cleanupIndex.size() <= size());
-  BOOST_ASSERT(m_freeCsEntries.size() > 0);
+  cs::Entry* entry = &shard.head;
 
-  m_mutex.lock();
+  //start from the upper layer towards bottom
+  for (size_t layer = shard.nLayers; layer-- > 0;) {
+    cs::Entry* next = entry->getNext(layer);
 
-  // take entry for the memory pool
-  cs::Entry* entry = m_freeCsEntries.front();
-  m_freeCsEntries.pop();
-  m_nPackets++;
-  entry->setData(data, isUnsolicited);
+    while (next != 0 && compareKeys(next, key, keySize) < 0) {
+      entry = next;
+      next = entry->getNext(layer);
+    }
 
-  bool insertInFront = false;
-  bool isIterated = false;
-  SkipList::reverse_iterator topLayer = m_skipList.rbegin();
-  SkipListLayer::iterator updateTable[SKIPLIST_MAX_LAYERS];
-  SkipListLayer::iterator head = (*topLayer)->begin();
+    if (predecessors != 0)
+      predecessors[layer] = entry;
+  }
 
-  if (!(*topLayer)->empty()) {
-    //start from the upper layer towards bottom
-    int layer = m_skipList.size() - 1;
-    for (SkipList::reverse_iterator rit = topLayer; rit != m_skipList.rend(); ++rit) {
-      //if we didn't do any iterations on the higher layers, start from the begin() again
-      if (!isIterated)
-        head = (*rit)->begin();
-
-      updateTable[layer] = head;
-
-      if (head != (*rit)->end()) {
-        // it can happen when begin() contains the element in front of which we need to insert
-        if (!isIterated && ((*head)->getName() >= entry->getName())) {
-          --updateTable[layer];
-          insertInFront = true;
-        }
-        else {
-          SkipListLayer::iterator it = head;
-
-          while ((*it)->getName() < entry->getName()) {
-            head = it;
-            updateTable[layer] = it;
-            isIterated = true;
-
-            ++it;
-            if (it == (*rit)->end())
-              break;
-          }
-        }
-      }
+  return entry;
+}
 
-      if (layer > 0)
-        head = (*head)->getIterators().find(layer - 1)->second; // move HEAD to the lower layer
+cs::Entry*
+Cs::advancePredecessors(Shard& shard, const uint8_t* key, size_t keySize, cs::Entry** predecessors)
+{
+  cs::Entry* entry = &shard.head;
+
+  for (size_t layer = shard.nLayers; layer-- > 0;) {
+    // continue from the previous predecessor on this layer if it is ahead of the one from above
+    cs::Entry* finger = predecessors[layer];
+    if (finger != &shard.head &&
+        (entry == &shard.head || compareKeys(finger, entry->getKey(), entry->getKeySize()) > 0)) {
+      entry = finger;
+    }
 
-      layer--;
+    cs::Entry* next = entry->getNext(layer);
+    while (next != 0 && compareKeys(next, key, keySize) < 0) {
+      entry = next;
+      next = entry->getNext(layer);
     }
+
+    predecessors[layer] = entry;
+  }
+
+  return entry;
+}
+
+cs::Entry*
+Cs::createEntry(Shard& shard, const Data& data, bool isUnsolicited, const ndn::ConstBufferPtr& digest)
+{
+  // take entry for the memory pool
+  cs::Entry* entry = shard.pool.allocate();
+  if (static_cast<bool>(digest)) {
+    entry->setData(data, isUnsolicited, digest);
   }
   else {
-    updateTable[0] = (*topLayer)->begin(); //initialization
+    entry->setData(data, isUnsolicited);
   }
 
-  head = updateTable[0];
-  ++head; // look at the next slot to check if it contains a duplicate
+  return entry;
+}
 
-  bool isCsEmpty = (size() == 0);
-  bool isInBoundaries = (head != (*m_skipList.begin())->end());
-  bool isNameIdentical = false;
-  if (!isCsEmpty && isInBoundaries) {
-    isNameIdentical = (*head)->getName() == entry->getName();
-  }
+std::pair<cs::Entry*, bool>
+Cs::insertToSkipList(Shard& shard, const Data& data, bool isUnsolicited, const ndn::ConstBufferPtr& digest)
+{
+  cs::Entry* entry = createEntry(shard, data, isUnsolicited, digest);
+
+  cs::Entry* predecessors[SKIPLIST_MAX_LAYERS];
+  findPredecessors(shard, entry->getKey(), entry->getKeySize(), predecessors);
+
+  return linkEntry(shard, entry, predecessors);
+}
+
+std::pair<cs::Entry*, bool>
+Cs::linkEntry(Shard& shard, cs::Entry* entry, cs::Entry** predecessors)
+{
+  cs::Entry* next = predecessors[0]->getNext(0);
 
   //check if this is a duplicate packet
-  if (isNameIdentical) {
-    (*head)->setData(data, isUnsolicited, entry->getDigest()); //updates stale time
+  if (next != 0 && compareKeys(next, entry->getKey(), entry->getKeySize()) == 0) {
+    // the indexes refer to the key memory, which setData() replaces
+    removeFromIndexes(shard, next);
+    shard.expiryWheel.erase(next);
+    m_nBytes -= getEntrySize(next);
+    next->setData(entry->getData(), entry->isUnsolicited(), entry->getDigest()); //updates stale time
+    m_nBytes += getEntrySize(next);
+    shard.expiryWheel.insert(next);
+    addToIndexes(shard, next);
 
     // new entry not needed, returning to the pool
     entry->release();
-    m_freeCsEntries.push(entry);
-    m_nPackets--;
+    shard.pool.deallocate(entry);
 
-    m_mutex.unlock();
-    return std::make_pair(*head, false);
+    return std::make_pair(next, false);
   }
 
-  size_t randomLayer = pickRandomLayer();
+  size_t height = pickRandomLayer() + 1;
 
-  while (m_skipList.size() < randomLayer + 1) {
-    SkipListLayer* newLayer = new SkipListLayer();
-    m_skipList.push_back(newLayer);
+  for (; shard.nLayers < height; shard.nLayers++)
+    predecessors[shard.nLayers] = &shard.head;
 
-    updateTable[(m_skipList.size() - 1)] = newLayer->begin();
+  entry->setHeight(height);
+  for (size_t layer = 0; layer < height; layer++) {
+    entry->setNext(layer, predecessors[layer]->getNext(layer));
+    predecessors[layer]->setNext(layer, entry);
+    predecessors[layer] = entry;
   }
 
-  size_t layer = 0;
-  for (SkipList::iterator i = m_skipList.begin(); i != m_skipList.end() && layer <= randomLayer; ++i) {
-    if (updateTable[layer] == (*i)->end() && !insertInFront) {
-      (*i)->push_back(entry);
-      SkipListLayer::iterator last = (*i)->end();
-      --last;
-      entry->setIterator(layer, last);
+  addToIndexes(shard, entry);
+  shard.expiryWheel.insert(entry);
+
+  shard.nPackets++;
+  m_nPackets++;
+  m_nBytes += getEntrySize(entry);
+  return std::make_pair(entry, true);
+}
+
+bool
+Cs::insert(const Data& data, bool isUnsolicited, const ndn::ConstBufferPtr& digest)
+{
+  const Block& nameWire = data.getName().wireEncode();
+  Shard& shard = getShard(nameWire.value(), nameWire.value_size());
+
+  EvictionList evicted;
+  bool isInserted = false;
+  {
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+
+    // stale packets make room before the policy evicts fresh ones
+    if (m_isExpiring)
+      expireItems(shard, evicted);
+
+    // the victim comes from this shard if it has one, otherwise from the others below
+    if (m_nPackets >= m_nMaxPackets) {
+      evictItem(shard, evicted);
     }
-    else if (updateTable[layer] == (*i)->end() && insertInFront) {
-      (*i)->push_front(entry);
-      entry->setIterator(layer, (*i)->begin());
+
+    //pointer and insertion status
+    std::pair<cs::Entry*, bool> entry = insertToSkipList(shard, data, isUnsolicited, digest);
+
+    //new entry
+    if (static_cast<bool>(entry.first) && (entry.second == true)) {
+      shard.policy->afterInsert(entry.first);
+      isInserted = true;
     }
-    else {
-      ++updateTable[layer]; // insert after
-      SkipListLayer::iterator position = (*i)->insert(updateTable[layer], entry);
-      entry->setIterator(layer, position); // save iterator where item was inserted
+    else if (static_cast<bool>(entry.first)) {
+      shard.policy->afterRefresh(entry.first);
     }
-    layer++;
+
+    enforceByteLimit(shard, evicted);
   }
 
-  m_mutex.unlock();
-  return std::make_pair(entry, true);
+  enforceLimit(evicted);
+  announceEvictions(evicted);
+  return isInserted;
 }
 
-bool
-Cs::insert(const Data& data, bool isUnsolicited)
+size_t
+Cs::insertBatch(const std::vector<shared_ptr<Data>>& packets, const std::vector<ndn::ConstBufferPtr>& digests,
+                bool isUnsolicited)
 {
-  if (isFull()) {
-    evictItem();
+  BOOST_ASSERT(digests.empty() || digests.size() == packets.size());
+
+  // group the packets by shard, keeping their order
+  std::vector<std::vector<size_t>> groups(m_shards.size());
+  for (size_t i = 0; i < packets.size(); i++) {
+    const Block& nameWire = packets[i]->getName().wireEncode();
+    groups[getShardIndex(nameWire.value(), nameWire.value_size())].push_back(i);
   }
 
-  //pointer and insertion status
-  std::pair<cs::Entry*, bool> entry = insertToSkipList(data, isUnsolicited);
+  EvictionList evicted;
+  size_t nInserted = 0;
 
-  //new entry
-  if (static_cast<bool>(entry.first) && (entry.second == true)) {
-    m_cleanupIndex.push_back(entry.first);
-    return true;
+  for (size_t shardIndex = 0; shardIndex < m_shards.size(); shardIndex++) {
+    const std::vector<size_t>& group = groups[shardIndex];
+    if (group.empty())
+      continue;
+
+    Shard& shard = *m_shards[shardIndex];
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+
+    if (m_isExpiring)
+      expireItems(shard, evicted);
+
+    std::vector<cs::Entry*> entries;
+    entries.reserve(group.size());
+
+    size_t nNew = 0;
+    for (size_t i = 0; i < group.size(); i++) {
+      const ndn::ConstBufferPtr& digest = digests.empty() ? ndn::ConstBufferPtr() : digests[group[i]];
+      entries.push_back(createEntry(shard, *packets[group[i]], isUnsolicited, digest));
+
+      NameKey fullName = {entries.back()->getKey(), entries.back()->getKeySize()};
+      if (shard.fullNameIndex.count(fullName) == 0)
+        nNew++;
+    }
+
+    // make room before linking, so that evictions do not invalidate the predecessors;
+    // packets of the batch are evicted only if the batch alone exceeds the limit
+    while (shard.nPackets > 0 && m_nPackets + nNew > m_nMaxPackets) {
+      if (!evictItem(shard, evicted))
+        break;
+    }
+
+    cs::Entry* predecessors[SKIPLIST_MAX_LAYERS];
+    std::fill(predecessors, predecessors + SKIPLIST_MAX_LAYERS, &shard.head);
+    const cs::Entry* previous = 0;
+
+    for (size_t i = 0; i < entries.size(); i++) {
+      cs::Entry* entry = entries[i];
+
+      if (m_nPackets >= m_nMaxPackets && evictItem(shard, evicted))
+        previous = 0; // the victim may be one of the predecessors
+
+      // out of order names are searched from the top
+      if (previous == 0 || compareKeys(entry, previous->getKey(), previous->getKeySize()) <= 0)
+        findPredecessors(shard, entry->getKey(), entry->getKeySize(), predecessors);
+      else
+        advancePredecessors(shard, entry->getKey(), entry->getKeySize(), predecessors);
+
+      std::pair<cs::Entry*, bool> result = linkEntry(shard, entry, predecessors);
+      if (result.second) {
+        shard.policy->afterInsert(result.first);
+        nInserted++;
+      }
+      else {
+        shard.policy->afterRefresh(result.first);
+      }
+      previous = result.first;
+    }
+
+    enforceByteLimit(shard, evicted);
   }
 
-  return false;
+  // the other shards make room for the packets that their own shards could not
+  enforceLimit(evicted);
+  announceEvictions(evicted);
+  return nInserted;
 }
 
 size_t
@@ -237,249 +630,284 @@ Cs::pickRandomLayer() const
   do {
     layer++;
     randomValue = rand() % 100 + 1;
-  } while ((randomValue < SKIPLIST_PROBABILITY) && (layer < SKIPLIST_MAX_LAYERS));
+  } while ((randomValue < SKIPLIST_PROBABILITY) && (layer < SKIPLIST_MAX_LAYERS - 1));
 
   return static_cast<size_t>(layer);
 }
 
 bool
-Cs::isFull() const
+Cs::eraseFromSkipList(Shard& shard, cs::Entry* entry)
 {
-  if (size() >= m_nMaxPackets) //size of the first layer vs. max size
-    return true;
+  cs::Entry* predecessors[SKIPLIST_MAX_LAYERS];
+  findPredecessors(shard, entry->getKey(), entry->getKeySize(), predecessors);
 
-  return false;
+  bool isErased = false;
+  for (size_t layer = 0; layer < entry->getHeight(); layer++) {
+    if (predecessors[layer]->getNext(layer) == entry) {
+      predecessors[layer]->setNext(layer, entry->getNext(layer));
+      isErased = true;
+    }
+  }
+
+  //remove layers that do not contain any elements (starting from the second layer)
+  while (shard.nLayers > 1 && shard.head.getNext(shard.nLayers - 1) == 0)
+    shard.nLayers--;
+
+  if (isErased) {
+    removeFromIndexes(shard, entry);
+    shard.expiryWheel.erase(entry);
+    m_nBytes -= getEntrySize(entry);
+    entry->release();
+    shard.pool.deallocate(entry);
+    shard.nPackets--;
+    m_nPackets--;
+  }
+
+  return isErased;
 }
 
 bool
-Cs::eraseFromSkipList(cs::Entry* entry)
+Cs::evictItem(Shard& shard, EvictionList& evicted)
 {
-  m_mutex.lock();
-  bool isErased = false;
+  cs::Entry* victim = shard.policy->pickVictim();
+  if (victim == 0)
+    return false;
 
-  const std::map<int, std::list<cs::Entry*>::iterator>& iterators = entry->getIterators();
+  shard.policy->beforeErase(victim);
+  Eviction eviction = {victim->getData().shared_from_this(), victim->getStaleTime(), false};
+  evicted.push_back(eviction);
+  eraseFromSkipList(shard, victim);
+  shard.nEvictions++;
 
-  if (!iterators.empty()) {
-    int layer = 0;
+  return true;
+}
 
-    for (SkipList::iterator it = m_skipList.begin(); it != m_skipList.end();) {
-      std::map<int, std::list<cs::Entry*>::iterator>::const_iterator i = iterators.find(layer);
+void
+Cs::announceEvictions(const EvictionList& evicted)
+{
+  // stale packets are not worth keeping on disk
+  if (m_diskTier.isOpen()) {
+    for (size_t i = 0; i < evicted.size(); i++) {
+      if (!evicted[i].isExpired)
+        m_diskTier.insert(*evicted[i].data, evicted[i].staleTime);
+    }
+  }
 
-      if (i != iterators.end()) {
-        (*it)->erase(i->second);
-        entry->removeIterator(layer);
-        isErased = true;
+  if (!static_cast<bool>(m_onEviction))
+    return;
 
-        //remove layers that do not contain any elements (starting from the second layer)
-        if ((layer != 0) && (*it)->empty()) {
-          delete *it;
-          it = m_skipList.erase(it);
-        }
-        else
-          ++it;
+  for (size_t i = 0; i < evicted.size(); i++)
+    m_onEviction(*evicted[i].data);
+}
 
-        layer++;
-      }
-      else
-        break;
-    }
-  }
+void
+Cs::addToIndexes(Shard& shard, cs::Entry* entry)
+{
+  BOOST_ASSERT(entry->getKeySize() >= DIGEST_COMPONENT_SIZE);
 
-  //delete entry;
-  if (isErased) {
-    entry->release();
-    m_freeCsEntries.push(entry);
-    m_nPackets--;
-  }
+  NameKey fullName = {entry->getKey(), entry->getKeySize()};
+  NameKey name = {entry->getKey(), entry->getKeySize() - DIGEST_COMPONENT_SIZE};
 
-  m_mutex.unlock();
-  return isErased;
+  shard.fullNameIndex[fullName] = entry;
+  shard.nameIndex.insert(std::make_pair(name, entry));
+}
+
+void
+Cs::removeFromIndexes(Shard& shard, cs::Entry* entry)
+{
+  NameKey fullName = {entry->getKey(), entry->getKeySize()};
+  NameKey name = {entry->getKey(), entry->getKeySize() - DIGEST_COMPONENT_SIZE};
+
+  shard.fullNameIndex.erase(fullName);
+
+  std::pair<NameIndex::iterator, NameIndex::iterator> range = shard.nameIndex.equal_range(name);
+  for (NameIndex::iterator it = range.first; it != range.second; ++it) {
+    if (it->second == entry) {
+      shard.nameIndex.erase(it);
+      break;
+    }
+  }
 }
 
 bool
-Cs::evictItem()
+Cs::findExact(Shard& shard, const Interest& interest, const NameKey& key, cs::Entry*& entry)
 {
-  if (!m_cleanupIndex.get<byArrival>().empty()) {
-    eraseFromSkipList(*m_cleanupIndex.get<byArrival>().begin());
-    m_cleanupIndex.get<byArrival>().erase(m_cleanupIndex.get<byArrival>().begin());
+  const Name& name = interest.getName();
+  entry = 0;
+
+  // Data names do not contain implicit digests, so only this exact packet can match
+  if (!name.empty() && name.get(-1).isImplicitSha256Digest() && interest.getMinSuffixComponents() <= 0) {
+    FullNameIndex::const_iterator it = shard.fullNameIndex.find(key);
+
+    if (it != shard.fullNameIndex.end() && doesComplyWithSelectors(interest, it->second, true)) {
+      entry = it->second;
+    }
     return true;
   }
 
+  // a packet with exactly Interest name sorts before its longer siblings (the digest
+  // component has the smallest type), so it is the leftmost child if it complies with selectors
+  if (interest.getChildSelector() <= 0) {
+    std::pair<NameIndex::const_iterator, NameIndex::const_iterator> range = shard.nameIndex.equal_range(key);
+
+    if (range.first != range.second && std::next(range.first) == range.second &&
+        doesComplyWithSelectors(interest, range.first->second, false)) {
+      entry = range.first->second;
+      return true;
+    }
+  }
+
+  // not found, several packets with the same name, or selectors need the ordered walk
   return false;
 }
 
-const Data*
+shared_ptr<const Data>
 Cs::find(const Interest& interest)
 {
-  m_mutex.lock();
+  shared_ptr<const Data> data = findInMemory(interest);
 
-  bool isIterated = false;
-  SkipList::const_reverse_iterator topLayer = m_skipList.rbegin();
-  SkipListLayer::iterator head = (*topLayer)->begin();
+  if (!static_cast<bool>(data) && m_diskTier.isOpen())
+    data = m_diskTier.find(interest);
 
-  if (!(*topLayer)->empty()) {
-    //start from the upper layer towards bottom
-    int layer = m_skipList.size() - 1;
-    for (SkipList::const_reverse_iterator rit = topLayer; rit != m_skipList.rend(); ++rit) {
-      //if we didn't do any iterations on the higher layers, start from the begin() again
-      if (!isIterated)
-        head = (*rit)->begin();
-
-      if (head != (*rit)->end()) {
-        // it happens when begin() contains the element we want to find
-        if (!isIterated && (interest.getName().isPrefixOf((*head)->getName()))) {
-          if (layer > 0) {
-            layer--;
-            continue; // try lower layer
-          }
-          else {
-            isIterated = true;
-          }
-        }
-        else {
-          SkipListLayer::iterator it = head;
+  return data;
+}
 
-          while ((*it)->getName() < interest.getName()) {
-            head = it;
-            isIterated = true;
+shared_ptr<const Data>
+Cs::findInMemory(const Interest& interest)
+{
+  const Name& name = interest.getName();
+  const Block& nameWire = name.wireEncode();
+  NameKey key = {nameWire.value(), nameWire.value_size()};
+
+  // exact match lives in the shard of the Interest name without the implicit digest
+  size_t nameKeySize = key.size;
+  if (!name.empty() && name.get(-1).isImplicitSha256Digest()) {
+    nameKeySize -= DIGEST_COMPONENT_SIZE;
+  }
 
-            ++it;
-            if (it == (*rit)->end())
-              break;
-          }
-        }
+  {
+    Shard& shard = getShard(key.value, nameKeySize);
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+
+    cs::Entry* entry = 0;
+    if (findExact(shard, interest, key, entry)) {
+      if (entry == 0) {
+        shard.nMisses++;
+        return shared_ptr<const Data>();
       }
 
-      if (layer > 0) {
-        head = (*head)->getIterators().find(layer - 1)->second; // move HEAD to the lower layer
-      }
-      else //if we reached the first layer
-      {
-        if (isIterated) {
-          m_mutex.unlock();
-          return selectChild(interest, head);
-        }
+      shard.nHits++;
+      shard.policy->beforeUse(entry);
+      return entry->getData().shared_from_this();
+    }
+  }
+
+  // names under Interest prefix are spread over all shards; the shards stay locked
+  // until the best answer is chosen, because the candidates point into them
+  std::vector<boost::unique_lock<boost::mutex>> locks;
+  locks.reserve(m_shards.size());
+
+  bool hasLeftmostSelector = (interest.getChildSelector() <= 0);
+  cs::Entry* bestMatch = 0;
+  Shard* bestMatchShard = 0;
+  size_t bestChildKeySize = 0;
+
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    Shard& shard = *m_shards[i];
+    locks.push_back(boost::unique_lock<boost::mutex>(shard.mutex));
+
+    cs::Entry* predecessor = findPredecessors(shard, key.value, key.size, 0);
+    cs::Entry* candidate = selectChild(interest, predecessor->getNext(0));
+    if (candidate == 0)
+      continue;
+
+    if (hasLeftmostSelector) {
+      if (bestMatch == 0 || compareKeys(candidate, bestMatch->getKey(), bestMatch->getKeySize()) < 0) {
+        bestMatch = candidate;
+        bestMatchShard = &shard;
       }
+      continue;
+    }
 
-      layer--;
+    // the leftmost packet of the rightmost child
+    size_t childKeySize = getChildKeySize(interest, candidate, recognizeInterestWithDigest(interest, candidate));
+    int order = bestMatch == 0 ? 1 : compareKeys(candidate->getKey(), childKeySize,
+                                                 bestMatch->getKey(), bestChildKeySize);
+
+    if (order > 0 || (order == 0 && compareKeys(candidate, bestMatch->getKey(), bestMatch->getKeySize()) < 0)) {
+      bestMatch = candidate;
+      bestMatchShard = &shard;
+      bestChildKeySize = childKeySize;
     }
   }
 
-  m_mutex.unlock();
-  return 0;
+  // the lookup is counted once, in the first shard
+  if (bestMatch == 0) {
+    m_shards.front()->nMisses++;
+    return shared_ptr<const Data>();
+  }
+
+  m_shards.front()->nHits++;
+  bestMatchShard->policy->beforeUse(bestMatch);
+  return bestMatch->getData().shared_from_this();
 }
 
-const Data*
-Cs::selectChild(const Interest& interest, SkipListLayer::iterator startingPoint) const
+cs::Entry*
+Cs::selectChild(const Interest& interest, cs::Entry* startingPoint) const
 {
-  BOOST_ASSERT(startingPoint != (*m_skipList.begin())->end());
-
-  if (startingPoint != (*m_skipList.begin())->begin()) {
-    BOOST_ASSERT((*startingPoint)->getName() < interest.getName());
-  }
+  const Name& interestName = interest.getName();
+  const Block& nameWire = interestName.wireEncode();
 
   bool hasLeftmostSelector = (interest.getChildSelector() <= 0);
-  bool hasRightmostSelector = !hasLeftmostSelector;
 
-  if (hasLeftmostSelector) {
-    bool doesInterestContainDigest = recognizeInterestWithDigest(interest, *startingPoint);
-    bool isInPrefix = false;
+  cs::Entry* rightmost = 0;
+  size_t rightmostChildKeySize = 0;
+
+  //iterate to the right
+  for (cs::Entry* entry = startingPoint; entry != 0; entry = entry->getNext(0)) {
+    bool doesInterestContainDigest = recognizeInterestWithDigest(interest, entry);
 
+    // the digest is checked by selectors, the rest of Interest name must be a prefix
+    size_t prefixKeySize = nameWire.value_size();
     if (doesInterestContainDigest) {
-      isInPrefix = interest.getName().getPrefix(-1).isPrefixOf((*startingPoint)->getName());
-    }
-    else {
-      isInPrefix = interest.getName().isPrefixOf((*startingPoint)->getName());
+      prefixKeySize -= interestName.get(-1).wireEncode().size();
     }
 
-    if (isInPrefix) {
-      if (doesComplyWithSelectors(interest, *startingPoint, doesInterestContainDigest)) {
-        return &(*startingPoint)->getData();
-      }
-    }
-  }
+    bool isInPrefix = (prefixKeySize <= entry->getKeySize() &&
+                       std::memcmp(nameWire.value(), entry->getKey(), prefixKeySize) == 0);
+    if (!isInPrefix)
+      break;
 
-  //iterate to the right
-  SkipListLayer::iterator rightmost = startingPoint;
-  if (startingPoint != (*m_skipList.begin())->end()) {
-    SkipListLayer::iterator rightmostCandidate = startingPoint;
-    Name currentChildPrefix("");
-
-    while (true) {
-      ++rightmostCandidate;
-
-      bool isInBoundaries = (rightmostCandidate != (*m_skipList.begin())->end());
-      bool isInPrefix = false;
-      bool doesInterestContainDigest = false;
-      if (isInBoundaries) {
-        doesInterestContainDigest = recognizeInterestWithDigest(interest, *rightmostCandidate);
-
-        if (doesInterestContainDigest) {
-          isInPrefix = interest.getName().getPrefix(-1).isPrefixOf((*rightmostCandidate)->getName());
-        }
-        else {
-          isInPrefix = interest.getName().isPrefixOf((*rightmostCandidate)->getName());
-        }
-      }
+    if (!doesComplyWithSelectors(interest, entry, doesInterestContainDigest))
+      continue;
 
-      if (isInPrefix) {
-        if (doesComplyWithSelectors(interest, *rightmostCandidate, doesInterestContainDigest)) {
-          if (hasLeftmostSelector) {
-            return &(*rightmostCandidate)->getData();
-          }
-
-          if (hasRightmostSelector) {
-            if (doesInterestContainDigest) {
-              // get prefix which is one component longer than Interest name
-              // (without digest)
-              const Name& childPrefix = (*rightmostCandidate)->getName().getPrefix(interest.getName().size());
-
-              if (currentChildPrefix.empty() || (childPrefix != currentChildPrefix)) {
-                currentChildPrefix = childPrefix;
-                rightmost = rightmostCandidate;
-              }
-            }
-            else {
-              // get prefix which is one component longer than Interest name
-              const Name& childPrefix = (*rightmostCandidate)->getName().getPrefix(interest.getName().size() + 1);
-
-              if (currentChildPrefix.empty() || (childPrefix != currentChildPrefix)) {
-                currentChildPrefix = childPrefix;
-                rightmost = rightmostCandidate;
-              }
-            }
-          }
-        }
-      }
-      else
-        break;
-    }
-  }
+    if (hasLeftmostSelector)
+      return entry;
 
-  if (rightmost != startingPoint) {
-    return &(*rightmost)->getData();
+    // the result is the leftmost entry of the rightmost child
+    size_t childKeySize = getChildKeySize(interest, entry, doesInterestContainDigest);
+
+    if (rightmost == 0 || childKeySize != rightmostChildKeySize ||
+        std::memcmp(entry->getKey(), rightmost->getKey(), childKeySize) != 0) {
+      rightmost = entry;
+      rightmostChildKeySize = childKeySize;
+    }
   }
 
-  if (hasRightmostSelector) // if rightmost was not found, try starting point
-  {
-    bool doesInterestContainDigest = recognizeInterestWithDigest(interest, *startingPoint);
-    bool isInPrefix = false;
+  return rightmost;
+}
 
-    if (doesInterestContainDigest) {
-      isInPrefix = interest.getName().getPrefix(-1).isPrefixOf((*startingPoint)->getName());
-    }
-    else {
-      isInPrefix = interest.getName().isPrefixOf((*startingPoint)->getName());
-    }
+size_t
+Cs::getChildKeySize(const Interest& interest, const cs::Entry* entry, bool doesInterestContainDigest) const
+{
+  const Name& interestName = interest.getName();
 
-    if (isInPrefix) {
-      if (doesComplyWithSelectors(interest, *startingPoint, doesInterestContainDigest)) {
-        return &(*startingPoint)->getData();
-      }
-    }
+  // get prefix which is one component longer than Interest name (without digest)
+  if (!doesInterestContainDigest && entry->getName().size() > interestName.size()) {
+    return interestName.wireEncode().value_size() + entry->getName().get(interestName.size()).wireEncode().size();
   }
 
-  return 0;
+  return entry->getKeySize();
 }
 
 bool
@@ -574,81 +1002,107 @@ Cs::recognizeInterestWithDigest(const Interest& interest, cs::Entry* entry) cons
 void
 Cs::erase(const Name& exactName)
 {
-  m_mutex.lock();
-
-  bool isIterated = false;
-  SkipListLayer::iterator updateTable[SKIPLIST_MAX_LAYERS];
-  SkipList::reverse_iterator topLayer = m_skipList.rbegin();
-  SkipListLayer::iterator head = (*topLayer)->begin();
+  const Block& nameWire = exactName.wireEncode();
+  if (exactName.empty() || !exactName.get(-1).isImplicitSha256Digest())
+    return; // CS entries are named with the implicit digest
 
-  if (!(*topLayer)->empty()) {
-    //start from the upper layer towards bottom
-    int layer = m_skipList.size() - 1;
-    for (SkipList::reverse_iterator rit = topLayer; rit != m_skipList.rend(); ++rit) {
-      //if we didn't do any iterations on the higher layers, start from the begin() again
-      if (!isIterated)
-        head = (*rit)->begin();
-
-      updateTable[layer] = head;
-
-      if (head != (*rit)->end()) {
-        // it can happen when begin() contains the element we want to remove
-        if (!isIterated && ((*head)->getName() == exactName)) {
-          eraseFromSkipList(*head);
-          m_mutex.unlock();
-          return;
-        }
-        else {
-          SkipListLayer::iterator it = head;
-
-          while ((*it)->getName() < exactName) {
-            head = it;
-            updateTable[layer] = it;
-            isIterated = true;
-
-            ++it;
-            if (it == (*rit)->end())
-              break;
-          }
-        }
-      }
+  Shard& shard = getShard(nameWire.value(), nameWire.value_size() - DIGEST_COMPONENT_SIZE);
+  {
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
 
-      if (layer > 0)
-        head = (*head)->getIterators().find(layer - 1)->second; // move HEAD to the lower layer
+    cs::Entry* entry = findPredecessors(shard, nameWire.value(), nameWire.value_size(), 0)->getNext(0);
 
-      layer--;
+    if (entry != 0 && compareKeys(entry, nameWire.value(), nameWire.value_size()) == 0) {
+      shard.policy->beforeErase(entry);
+      eraseFromSkipList(shard, entry);
     }
   }
-  else {
-    m_mutex.unlock();
-    return;
-  }
 
-  head = updateTable[0];
-  ++head; // look at the next slot to check if it contains the item we want to remove
+  // the disk tier knows Data names only
+  m_diskTier.erase(exactName.getPrefix(-1));
+}
+
+size_t
+Cs::erasePrefix(const Name& prefix)
+{
+  const Block& nameWire = prefix.wireEncode();
+  const uint8_t* key = nameWire.value();
+  size_t keySize = nameWire.value_size();
+
+  size_t nErased = 0;
+
+  // names under the prefix are spread over all shards
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    Shard& shard = *m_shards[i];
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+
+    cs::Entry* predecessors[SKIPLIST_MAX_LAYERS];
+    findPredecessors(shard, key, keySize, predecessors);
+
+    cs::Entry* first = predecessors[0]->getNext(0);
+
+    // entries under the prefix are contiguous, so every layer is cut once
+    for (size_t layer = 0; layer < shard.nLayers; layer++) {
+      cs::Entry* next = predecessors[layer]->getNext(layer);
+      while (next != 0 && next->getKeySize() >= keySize && std::memcmp(next->getKey(), key, keySize) == 0)
+        next = next->getNext(layer);
+
+      predecessors[layer]->setNext(layer, next);
+    }
 
-  bool isCsEmpty = (size() == 0);
-  bool isInBoundaries = (head != (*m_skipList.begin())->end());
-  bool isNameIdentical = false;
-  if (!isCsEmpty && isInBoundaries) {
-    isNameIdentical = (*head)->getName() == exactName;
+    while (shard.nLayers > 1 && shard.head.getNext(shard.nLayers - 1) == 0)
+      shard.nLayers--;
+
+    // the unlinked entries still point to each other on the first layer
+    cs::Entry* entry = first;
+    while (entry != 0 && entry->getKeySize() >= keySize && std::memcmp(entry->getKey(), key, keySize) == 0) {
+      cs::Entry* next = entry->getNext(0);
+
+      shard.policy->beforeErase(entry);
+      removeFromIndexes(shard, entry);
+      shard.expiryWheel.erase(entry);
+      m_nBytes -= getEntrySize(entry);
+      entry->release();
+      shard.pool.deallocate(entry);
+      shard.nPackets--;
+      m_nPackets--;
+      nErased++;
+
+      entry = next;
+    }
   }
 
-  if (isNameIdentical) {
-    eraseFromSkipList(*head);
+  m_diskTier.erasePrefix(prefix);
+  return nErased;
+}
+
+void
+Cs::getPackets(std::vector<shared_ptr<const Data>>& packets,
+               std::vector<time::steady_clock::TimePoint>& staleTimes) const
+{
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    const Shard& shard = *m_shards[i];
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+
+    for (cs::Entry* entry = shard.head.getNext(0); entry != 0; entry = entry->getNext(0)) {
+      packets.push_back(entry->getData().shared_from_this());
+      staleTimes.push_back(entry->getStaleTime());
+    }
   }
 }
 
 void
 Cs::printSkipList() const
 {
-  //start from the upper layer towards bottom
-  int layer = m_skipList.size() - 1;
-  for (SkipList::const_reverse_iterator rit = m_skipList.rbegin(); rit != m_skipList.rend(); ++rit) {
-    for (SkipListLayer::iterator it = (*rit)->begin(); it != (*rit)->end(); ++it) {
-      std::cout << "Layer " << layer << " " << (*it)->getName() << std::endl;
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    const Shard& shard = *m_shards[i];
+
+    //start from the upper layer towards bottom
+    for (size_t layer = shard.nLayers; layer-- > 0;) {
+      for (cs::Entry* entry = shard.head.getNext(layer); entry != 0; entry = entry->getNext(layer)) {
+        std::cout << "Shard " << i << " Layer " << layer << " " << entry->getName() << std::endl;
+      }
     }
-    layer--;
   }
 }
 
@@ -23,60 +23,81 @@
 #define NFD_TABLE_CS_HPP
 
 #include "common.hpp"
+#include "cs-disk-tier.hpp"
 #include "cs-entry.hpp"
+#include "cs-entry-pool.hpp"
+#include "cs-expiry-wheel.hpp"
+#include "cs-policy.hpp"
 
-#include <boost/multi_index/identity.hpp>
-#include <boost/multi_index/member.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/sequenced_index.hpp>
-#include <boost/multi_index_container.hpp>
+#include <boost/atomic.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 
-#include <queue>
+#include <unordered_map>
+#include <vector>
 
 namespace ndn {
 
-typedef std::list<cs::Entry*> SkipListLayer;
-typedef std::list<SkipListLayer*> SkipList;
-
-class StalenessComparator
+/** \brief non-owning reference to a name key (see cs::Entry::getKey())
+ */
+struct NameKey
 {
-public:
+  const uint8_t* value;
+  size_t size;
+
   bool
-  operator()(const cs::Entry* entry1, const cs::Entry* entry2) const
+  operator==(const NameKey& other) const
   {
-    return entry1->getStaleTime() < entry2->getStaleTime();
+    return size == other.size && std::memcmp(value, other.value, size) == 0;
   }
 };
 
-class UnsolicitedComparator
+class NameKeyHash
 {
 public:
-  bool
-  operator()(const cs::Entry* entry1, const cs::Entry* entry2) const
+  size_t
+  operator()(const NameKey& key) const
   {
-    return entry1->isUnsolicited();
+    return boost::hash_range(key.value, key.value + key.size);
   }
 };
 
-// tags
-class unsolicited;
-class byStaleness;
-class byArrival;
-
-typedef boost::multi_index_container<cs::Entry*,
-                                     boost::multi_index::indexed_by<
-
-                                       // by arrival (FIFO)
-                                       boost::multi_index::sequenced<boost::multi_index::tag<byArrival>>>>
-  CleanupIndex;
+typedef std::unordered_map<NameKey, cs::Entry*, NameKeyHash> FullNameIndex;
+typedef std::unordered_multimap<NameKey, cs::Entry*, NameKeyHash> NameIndex;
 
 /** \brief represents Content Store
+ *
+ *  Entries are kept in a skip list ordered by name. Every cs::Entry is a node with an inline
+ *  tower of forward pointers, and names are compared as precomputed TLV keys with memcmp.
+ *
+ *  Two hash indexes, by Data name and by full name (with implicit digest), answer Interests
+ *  for exact names without walking the skip list.
+ *
+ *  The store is split into shards by the hash of Data name. Every shard has its own lock,
+ *  skip list, indexes and replacement queue, so that operations on different names run
+ *  in parallel. The limit applies to the whole store: a new packet pushes out the victim
+ *  of its own shard, or of the other shards in turn if its shard holds nothing else.
+ *  Exact lookups touch one shard; prefix lookups visit all shards and merge their answers.
+ *
+ *  The replacement policy is pluggable (see cs::Policy), every shard runs its own instance.
+ *
+ *  If expiry is enabled (see setExpiry), packets that became stale can be reclaimed before
+ *  the policy has to evict anything: every shard keeps its entries in a timer wheel by stale
+ *  time (see cs::ExpiryWheel), which is advanced on insertion and by removeExpired().
+ *
+ *  Optionally, packets evicted by the policy are spilled into a second tier on disk
+ *  (see cs::DiskTier), which answers the lookups that miss in memory.
  */
 class Cs : noncopyable
 {
 public:
-  explicit Cs(int nMaxPackets = 65536); // ~500MB with average packet size = 8KB
+  typedef function<void(const Data&)> EvictionCallback;
+
+  /** \brief creates Content Store limited to nMaxPackets packets, without a limit in bytes
+   *  Entries are allocated when packets arrive, not up front.
+   */
+  explicit Cs(int nMaxPackets = 65536, size_t nShards = 16);
 
   ~Cs();
 
@@ -86,23 +107,58 @@ public:
    *  Packets are considered duplicate if the name matches.
    *  The new Data packet with the identical name, but a different payload
    *  is not placed in the Content Store
+   *
+   *  If the implicit digest of the Data is already known (e.g. it was computed
+   *  for a manifest), it can be passed to avoid hashing the packet again.
    *  \return{ whether the Data is added }
    */
   bool
-  insert(const Data& data, bool isUnsolicited = false);
+  insert(const Data& data, bool isUnsolicited = false,
+         const ndn::ConstBufferPtr& digest = ndn::ConstBufferPtr());
+
+  /** \brief inserts Data packets, e.g. segments of one ADU
+   *  Duplicates are handled as in insert(). digests is either empty or holds the implicit
+   *  digest of every packet.
+   *
+   *  The packets are grouped by shard, and every shard is locked once for its group.
+   *  Packets with ascending names (as segments are produced) are linked into the skip list
+   *  from the position of the previous packet instead of searching from the top.
+   *  \return{ number of added packets }
+   */
+  size_t
+  insertBatch(const std::vector<shared_ptr<Data>>& packets,
+              const std::vector<ndn::ConstBufferPtr>& digests = std::vector<ndn::ConstBufferPtr>(),
+              bool isUnsolicited = false);
 
   /** \brief finds the best match Data for an Interest
-   *  \return{ the best match, if any; otherwise 0 }
+   *  The returned packet stays valid after it is evicted from Content Store.
+   *  If nothing matches in memory, the disk tier (if enabled) is searched.
+   *  \return{ the best match, if any; otherwise null }
    */
-  const Data*
+  shared_ptr<const Data>
   find(const Interest& interest);
 
-  /** \brief deletes CS entry by the exact name
+  /** \brief deletes CS entry by the exact name, the disk tier forgets the Data name as well
    */
   void
   erase(const Name& exactName);
 
-  /** \brief sets maximum allowed size of Content Store (in packets)
+  /** \brief deletes all CS entries under the prefix, e.g. all segments of an ADU
+   *  Every shard is locked once, and its entries under the prefix are unlinked in one pass.
+   *  The disk tier forgets the packets under the prefix as well.
+   *  \return{ number of deleted packets in memory }
+   */
+  size_t
+  erasePrefix(const Name& prefix);
+
+  /** \brief copies handles of all stored packets and their stale times, in name order per shard
+   *  (used to save Content Store, see cs::Snapshot)
+   */
+  void
+  getPackets(std::vector<shared_ptr<const Data>>& packets,
+             std::vector<time::steady_clock::TimePoint>& staleTimes) const;
+
+  /** \brief sets maximum allowed size of Content Store (in packets), at least one packet
    */
   void
   setLimit(size_t nMaxPackets);
@@ -119,19 +175,193 @@ public:
   size_t
   size() const;
 
+  /** \brief sets maximum allowed memory of Content Store (in bytes), 0 means no limit
+   *  Packets are evicted until both the packet and the byte limits are met.
+   *  The budget applies to the whole store, which keeps at least one packet.
+   */
+  void
+  setByteLimit(size_t nMaxBytes);
+
+  /** \brief returns maximum allowed memory of Content Store (in bytes), 0 means no limit
+   */
+  size_t
+  getByteLimit() const;
+
+  /** \brief returns memory taken by the stored packets (in bytes)
+   *  Counts the wire encoding of every packet, its name with digest and the digest,
+   *  and the entry with its index and policy nodes.
+   */
+  size_t
+  getNBytes() const;
+
+  /** \brief replaces the replacement policy, packets that are already stored are kept
+   *  \param policyType one of CS_POLICY_* values
+   *  \return{ false if the policy type is not known }
+   */
+  bool
+  setPolicy(int policyType);
+
+  /** \brief returns the type of the replacement policy
+   */
+  int
+  getPolicy() const;
+
+  /** \brief sets the function that is called for every packet evicted by the replacement policy
+   *  It is called without Content Store locks held. Must be set before Content Store is shared
+   *  between threads.
+   */
+  void
+  setEvictionCallback(const EvictionCallback& onEviction);
+
+  /** \brief returns the number of lookups that found a packet
+   */
+  uint64_t
+  getNHits() const;
+
+  /** \brief returns the number of lookups that did not find a packet
+   */
+  uint64_t
+  getNMisses() const;
+
+  /** \brief returns the number of packets evicted by the replacement policy
+   */
+  uint64_t
+  getNEvictions() const;
+
+  /** \brief enables or disables removal of stale packets (disabled by default)
+   */
+  void
+  setExpiry(bool isExpiring);
+
+  bool
+  isExpiring() const;
+
+  /** \brief removes the packets that are stale by now and announces them to the eviction callback
+   *  Insertions reclaim stale packets of their shard; this method should also be called
+   *  periodically, so that packets do not outlive their freshness when nothing is inserted.
+   *  \return{ number of removed packets }
+   */
+  size_t
+  removeExpired();
+
+  /** \brief returns the number of stale packets that were removed
+   */
+  uint64_t
+  getNExpirations() const;
+
+  /** \brief enables the disk tier: packets evicted by the replacement policy are appended
+   *  to a log file at path, and lookups that miss in memory are answered from it.
+   *  An empty path disables the tier and removes its file.
+   *  Must be called before Content Store is shared between threads.
+   *  \return{ false if the log file cannot be created }
+   */
+  bool
+  setDiskTier(const std::string& path);
+
+  /** \brief returns the disk tier (closed if disabled)
+   */
+  cs::DiskTier&
+  getDiskTier();
+
+  const cs::DiskTier&
+  getDiskTier() const;
+
 protected:
-  /** \brief removes one Data packet from Content Store based on replacement policy
+  /** \brief packet removed from Content Store, announced after the shard lock is released
+   */
+  struct Eviction
+  {
+    shared_ptr<const Data> data;
+    time::steady_clock::TimePoint staleTime;
+    bool isExpired; // removed because it became stale, not by the replacement policy
+  };
+
+  typedef std::vector<Eviction> EvictionList;
+
+  /** \brief part of Content Store guarded by one lock
+   */
+  struct Shard : noncopyable
+  {
+    Shard();
+
+    cs::Entry head; // sentinel, its tower starts every layer
+    size_t nLayers; // number of non-empty layers, at least one
+    FullNameIndex fullNameIndex;
+    NameIndex nameIndex;
+    unique_ptr<cs::Policy> policy;
+    size_t nPackets;                      // current number of packets in the shard
+    cs::EntryPool pool;                   // memory pool, grows on demand
+    cs::ExpiryWheel expiryWheel;          // entries by stale time
+    mutable boost::mutex mutex;
+
+    // statistics
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nEvictions;
+    uint64_t nExpirations;
+  };
+
+  /** \brief removes one Data packet from the shard based on replacement policy
+   *  Must be called with the shard mutex held.
+   *  The evicted packet is appended to evicted, to be announced after the mutex is released.
    *  \return{ whether the Data was removed }
    */
   bool
-  evictItem();
+  evictItem(Shard& shard, EvictionList& evicted);
+
+  /** \brief spills the packets evicted by the policy into the disk tier
+   *  and calls the eviction callback for all removed packets
+   */
+  void
+  announceEvictions(const EvictionList& evicted);
 
 private:
-  /** \brief returns True if the Content Store is at its maximum capacity
-   *  \return{ True if Content Store is full; otherwise False}
+  /** \brief finds the best match Data for an Interest among the packets in memory
+   */
+  shared_ptr<const Data>
+  findInMemory(const Interest& interest);
+
+  /** \brief removes the packets of the shard that are stale by now
+   *  Must be called with the shard mutex held.
+   *  \return{ number of removed packets }
+   */
+  size_t
+  expireItems(Shard& shard, EvictionList& evicted);
+
+  /** \brief returns the shard that holds packets with the Data name
+   */
+  Shard&
+  getShard(const uint8_t* nameKey, size_t nameKeySize);
+
+  size_t
+  getShardIndex(const uint8_t* nameKey, size_t nameKeySize) const;
+
+  /** \brief returns the number of packets a shard is expected to hold, which sizes its policy
+   */
+  size_t
+  getShardShare() const;
+
+  /** \brief checks if the store holds more packets or bytes than allowed
    */
   bool
-  isFull() const;
+  isOverLimit() const;
+
+  /** \brief evicts packets from the shards in turn until the store fits into its limits
+   *  Must be called without any shard mutex held.
+   */
+  void
+  enforceLimit(EvictionList& evicted);
+
+  /** \brief evicts packets of the shard until the store fits into its byte limit
+   *  Must be called with the shard mutex held.
+   */
+  void
+  enforceByteLimit(Shard& shard, EvictionList& evicted);
+
+  /** \brief returns the memory accounted to a CS entry (in bytes)
+   */
+  static size_t
+  getEntrySize(const cs::Entry* entry);
 
   /** \brief Computes the layer where new Content Store Entry is placed
    *
@@ -141,24 +371,82 @@ private:
   size_t
   pickRandomLayer() const;
 
+  /** \brief compares two name keys in the NDN canonical order
+   *  \return{ negative, zero or positive, like memcmp }
+   */
+  static int
+  compareKeys(const uint8_t* key1, size_t keySize1, const uint8_t* key2, size_t keySize2);
+
+  static int
+  compareKeys(const cs::Entry* entry, const uint8_t* key, size_t keySize);
+
+  /** \brief finds the last CS entry whose key is less than the given key on every layer
+   *  If predecessors is not null, the entry found on each layer is stored there.
+   *  Must be called with the shard mutex held.
+   *  \return{ the predecessor on the first layer, or the head of the skip list }
+   */
+  cs::Entry*
+  findPredecessors(Shard& shard, const uint8_t* key, size_t keySize, cs::Entry** predecessors);
+
+  /** \brief same as findPredecessors(), but continues from the predecessors found before
+   *  Every entry in predecessors must be the head or an entry with a key less than the given key.
+   *  Must be called with the shard mutex held.
+   */
+  cs::Entry*
+  advancePredecessors(Shard& shard, const uint8_t* key, size_t keySize, cs::Entry** predecessors);
+
+  /** \brief answers an Interest for an exact name or full name from the hash indexes
+   *  Must be called with the shard mutex held.
+   *  \return{ true if the answer is final (entry is the match or 0);
+   *            false if the Interest must be looked up in the skip lists }
+   */
+  bool
+  findExact(Shard& shard, const Interest& interest, const NameKey& key, cs::Entry*& entry);
+
+  /** \brief adds the CS entry to the hash indexes of the shard
+   */
+  void
+  addToIndexes(Shard& shard, cs::Entry* entry);
+
+  /** \brief removes the CS entry from the hash indexes of the shard
+   */
+  void
+  removeFromIndexes(Shard& shard, cs::Entry* entry);
+
   /** \brief Inserts a new Content Store Entry in a skip list
+   *  Must be called with the shard mutex held.
    *  \return{ returns a pair containing a pointer to the CS Entry,
    *  and a flag indicating if the entry was newly created (True) or refreshed (False) }
    */
   std::pair<cs::Entry*, bool>
-  insertToSkipList(const Data& data, bool isUnsolicited = false);
+  insertToSkipList(Shard& shard, const Data& data, bool isUnsolicited, const ndn::ConstBufferPtr& digest);
+
+  /** \brief takes a CS entry from the memory pool and fills it with the Data packet
+   *  Must be called with the shard mutex held.
+   */
+  cs::Entry*
+  createEntry(Shard& shard, const Data& data, bool isUnsolicited, const ndn::ConstBufferPtr& digest);
+
+  /** \brief links a filled CS entry after its predecessors, or refreshes the duplicate
+   *  predecessors must be found for the entry key on all layers. They are updated to point
+   *  to the new entry, so that an entry with a greater key can continue from them.
+   *  Must be called with the shard mutex held.
+   *  \return{ same as insertToSkipList() }
+   */
+  std::pair<cs::Entry*, bool>
+  linkEntry(Shard& shard, cs::Entry* entry, cs::Entry** predecessors);
 
   /** \brief Removes a specific CS Entry from all layers of a skip list
+   *  Must be called with the shard mutex held.
    *  \return{ returns True if CS Entry was succesfully removed and False if CS Entry was not found}
    */
   bool
-  eraseFromSkipList(cs::Entry* entry);
+  eraseFromSkipList(Shard& shard, cs::Entry* entry);
 
   /** \brief Implements child selector (leftmost, rightmost, undeclared).
    *  Operates on the first layer of a skip list.
    *
-   *  startingPoint must be less than Interest Name.
-   *  startingPoint can be equal to Interest Name only when the item is in the begin() position.
+   *  startingPoint is the first CS entry that is not less than Interest Name (may be null).
    *
    *  Iterates toward greater Names, terminates when CS entry falls out of Interest prefix.
    *  When childSelector = leftmost, returns first CS entry that satisfies other selectors.
@@ -166,11 +454,18 @@ private:
    *  other selectors. Returned CS entry is the leftmost child of the rightmost child.
    *  \return{ the best match, if any; otherwise 0 }
    */
-  const Data*
-  selectChild(const Interest& interest, SkipListLayer::iterator startingPoint) const;
+  cs::Entry*
+  selectChild(const Interest& interest, cs::Entry* startingPoint) const;
+
+  /** \brief returns the size of the key prefix that names the child of Interest name
+   *  which contains the CS entry (the prefix one component longer than Interest name)
+   */
+  size_t
+  getChildKeySize(const Interest& interest, const cs::Entry* entry, bool doesInterestContainDigest) const;
 
   /** \brief checks if Content Store entry satisfies Interest selectors (MinSuffixComponents,
-   *  MaxSuffixComponents, Implicit Digest, MustBeFresh)
+   *  MaxSuffixComponents, Implicit Digest)
+   *  MustBeFresh is not checked: the producer serves its own Data regardless of freshness
    *  \return{ true if satisfies all selectors; false otherwise }
    */
   bool
@@ -183,18 +478,22 @@ private:
   bool
   recognizeInterestWithDigest(const Interest& interest, cs::Entry* entry) const;
 
-  /** \brief Prints contents of the skip list, starting from the top layer
+  /** \brief Prints contents of the skip lists, starting from the top layer
    */
   void
   printSkipList() const;
 
 private:
-  SkipList m_skipList;
-  CleanupIndex m_cleanupIndex;
-  size_t m_nMaxPackets;                   // user defined maximum size of the Content Store in packets
-  size_t m_nPackets;                      // current number of packets in Content Store
-  std::queue<cs::Entry*> m_freeCsEntries; // memory pool
-  boost::mutex m_mutex;
+  std::vector<unique_ptr<Shard>> m_shards;
+  boost::atomic<size_t> m_nMaxPackets;     // user defined maximum size of the Content Store in packets
+  boost::atomic<size_t> m_nPackets;        // packets in all shards
+  boost::atomic<size_t> m_nextVictimShard; // shard where enforceLimit() looks for the next victim
+  boost::atomic<size_t> m_nMaxBytes;       // user defined maximum size of the Content Store in bytes, 0 if none
+  boost::atomic<size_t> m_nBytes;          // memory accounted to the packets in all shards
+  int m_policyType;
+  bool m_isExpiring;
+  EvictionCallback m_onEviction;
+  cs::DiskTier m_diskTier;
 };
 
 } // namespace ndn
@@ -0,0 +1,229 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#include "pit.hpp"
+
+#include <algorithm>
+
+namespace ndn {
+
+Pit::Pit(size_t nMaxEntries)
+  : m_nEntries(0)
+  , m_nMaxEntries(nMaxEntries)
+{
+}
+
+size_t
+Pit::size() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_nEntries;
+}
+
+void
+Pit::setLimit(size_t nMaxEntries)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  m_nMaxEntries = nMaxEntries;
+}
+
+size_t
+Pit::getLimit() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_nMaxEntries;
+}
+
+bool
+Pit::insert(const Interest& interest)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+
+  time::steady_clock::TimePoint now = time::steady_clock::now();
+
+  if (m_nEntries >= m_nMaxEntries) {
+    removeExpired(now);
+
+    if (m_nEntries >= m_nMaxEntries) {
+      // the name is enough to send the Data once it is produced
+      time::steady_clock::TimePoint& expiry = m_overflow[interest.getName()];
+      expiry = std::max(expiry, now + interest.getInterestLifetime());
+
+      if (m_overflow.size() > m_nMaxEntries)
+        removeExpiredOverflow(now);
+
+      return false;
+    }
+  }
+
+  Entry entry;
+  entry.interest = interest.shared_from_this();
+  entry.expiry = now + interest.getInterestLifetime();
+
+  m_entries[interest.getName()].push_back(entry);
+  m_nEntries++;
+
+  return true;
+}
+
+size_t
+Pit::satisfy(const Data& data, const ConstBufferPtr& implicitDigest)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+
+  if (m_nEntries == 0 && m_overflow.empty())
+    return 0;
+
+  time::steady_clock::TimePoint now = time::steady_clock::now();
+  const Name& dataName = data.getName();
+  size_t nSatisfied = 0;
+
+  if (!m_overflow.empty())
+    nSatisfied += satisfyOverflow(data, implicitDigest, now);
+
+  // Interests name the Data packet or one of its prefixes
+  for (size_t i = 0; i <= dataName.size(); i++) {
+    EntriesByName::iterator it = m_entries.find(dataName.getPrefix(i));
+    if (it != m_entries.end()) {
+      nSatisfied += satisfyByName(it, data, false, now);
+    }
+  }
+
+  // Interests that carry the implicit digest are next to the Data name in the index
+  EntriesByName::iterator next = m_entries.upper_bound(dataName);
+  if (next != m_entries.end() && next->first.size() == dataName.size() + 1 &&
+      dataName.isPrefixOf(next->first)) {
+    Name fullName(dataName);
+    if (static_cast<bool>(implicitDigest))
+      fullName.append(name::Component::fromImplicitSha256Digest(implicitDigest));
+    else
+      fullName = data.getFullName();
+
+    EntriesByName::iterator it = m_entries.find(fullName);
+    if (it != m_entries.end()) {
+      nSatisfied += satisfyByName(it, data, true, now);
+    }
+  }
+
+  return nSatisfied;
+}
+
+size_t
+Pit::satisfyByName(EntriesByName::iterator it, const Data& data, bool hasMatchingDigest,
+                   const time::steady_clock::TimePoint& now)
+{
+  size_t nSatisfied = 0;
+  std::list<Entry>& entries = it->second;
+
+  for (std::list<Entry>::iterator entry = entries.begin(); entry != entries.end();) {
+    bool isExpired = entry->expiry < now;
+    bool isSatisfied = !isExpired && (hasMatchingDigest || entry->interest->matchesData(data));
+
+    if (isExpired || isSatisfied) {
+      entry = entries.erase(entry);
+      m_nEntries--;
+
+      if (isSatisfied)
+        nSatisfied++;
+    }
+    else {
+      ++entry;
+    }
+  }
+
+  if (entries.empty())
+    m_entries.erase(it);
+
+  return nSatisfied;
+}
+
+size_t
+Pit::satisfyOverflow(const Data& data, const ConstBufferPtr& implicitDigest,
+                     const time::steady_clock::TimePoint& now)
+{
+  const Name& dataName = data.getName();
+  size_t nSatisfied = 0;
+
+  for (size_t i = 0; i <= dataName.size(); i++) {
+    OverflowNames::iterator it = m_overflow.find(dataName.getPrefix(i));
+    if (it != m_overflow.end()) {
+      if (it->second >= now)
+        nSatisfied++;
+      m_overflow.erase(it);
+    }
+  }
+
+  OverflowNames::iterator next = m_overflow.upper_bound(dataName);
+  if (next != m_overflow.end() && next->first.size() == dataName.size() + 1 &&
+      dataName.isPrefixOf(next->first)) {
+    Name fullName(dataName);
+    if (static_cast<bool>(implicitDigest))
+      fullName.append(name::Component::fromImplicitSha256Digest(implicitDigest));
+    else
+      fullName = data.getFullName();
+
+    OverflowNames::iterator it = m_overflow.find(fullName);
+    if (it != m_overflow.end()) {
+      if (it->second >= now)
+        nSatisfied++;
+      m_overflow.erase(it);
+    }
+  }
+
+  return nSatisfied;
+}
+
+void
+Pit::removeExpiredOverflow(const time::steady_clock::TimePoint& now)
+{
+  for (OverflowNames::iterator it = m_overflow.begin(); it != m_overflow.end();) {
+    if (it->second < now)
+      it = m_overflow.erase(it);
+    else
+      ++it;
+  }
+}
+
+void
+Pit::removeExpired(const time::steady_clock::TimePoint& now)
+{
+  for (EntriesByName::iterator it = m_entries.begin(); it != m_entries.end();) {
+    std::list<Entry>& entries = it->second;
+
+    for (std::list<Entry>::iterator entry = entries.begin(); entry != entries.end();) {
+      if (entry->expiry < now) {
+        entry = entries.erase(entry);
+        m_nEntries--;
+      }
+      else {
+        ++entry;
+      }
+    }
+
+    if (entries.empty())
+      it = m_entries.erase(it);
+    else
+      ++it;
+  }
+}
+
+} // namespace ndn
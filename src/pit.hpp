@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#ifndef PIT_HPP
+#define PIT_HPP
+
+#include "common.hpp"
+#include "context-default-values.hpp"
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace ndn {
+
+/** \brief represents the table of Interests that reached the producer before the Data
+ *  they ask for was produced
+ *
+ *  Interests are indexed by name and kept until their lifetime expires or until
+ *  matching Data is inserted into the send buffer. Expired Interests are purged lazily,
+ *  when the table runs out of space. When the table is full, only the names of further
+ *  Interests are remembered, so that matching Data is still sent for them; their selectors
+ *  are not checked.
+ *  Interests are parked by processing threads and satisfied by the thread that produces Data.
+ */
+class Pit : noncopyable
+{
+public:
+  explicit Pit(size_t nMaxEntries = DEFAULT_PRODUCER_PIT_SIZE);
+
+  /** \brief parks an Interest until matching Data is produced or the Interest expires
+   *  \return{ false if the table is full and only the name of the Interest was remembered }
+   */
+  bool
+  insert(const Interest& interest);
+
+  /** \brief removes all parked Interests that can be satisfied by the Data
+   *  \param implicitDigest implicit digest of the Data, if it is already known;
+   *  otherwise it is computed only if some Interest names a Data packet with digest
+   *  \return{ number of satisfied Interests }
+   */
+  size_t
+  satisfy(const Data& data, const ConstBufferPtr& implicitDigest = ConstBufferPtr());
+
+  /** \brief returns the number of parked Interests
+   */
+  size_t
+  size() const;
+
+  void
+  setLimit(size_t nMaxEntries);
+
+  size_t
+  getLimit() const;
+
+private:
+  struct Entry
+  {
+    shared_ptr<const Interest> interest;
+    time::steady_clock::TimePoint expiry;
+  };
+
+  typedef std::map<Name, std::list<Entry>> EntriesByName;
+
+  void
+  removeExpired(const time::steady_clock::TimePoint& now);
+
+  /** \brief removes parked Interests under the name that are satisfied by the Data
+   */
+  size_t
+  satisfyByName(EntriesByName::iterator it, const Data& data, bool hasMatchingDigest,
+                const time::steady_clock::TimePoint& now);
+
+  /** \brief forgets the names of Interests that did not fit into the table and are
+   *  satisfied by the Data
+   */
+  size_t
+  satisfyOverflow(const Data& data, const ConstBufferPtr& implicitDigest,
+                  const time::steady_clock::TimePoint& now);
+
+  void
+  removeExpiredOverflow(const time::steady_clock::TimePoint& now);
+
+private:
+  // names of Interests that arrived when the table was full, with the latest expiry
+  typedef std::map<Name, time::steady_clock::TimePoint> OverflowNames;
+
+  EntriesByName m_entries;
+  OverflowNames m_overflow;
+  size_t m_nEntries;
+  size_t m_nMaxEntries;
+  mutable boost::mutex m_mutex;
+};
+
+} // namespace ndn
+
+#endif // PIT_HPP
@@ -20,10 +20,16 @@
  */
 
 #include "producer-context.hpp"
+#include "cs-snapshot.hpp"
+#include "sha256-batch.hpp"
 
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/encoding/encoding-buffer.hpp>
 #include <ndn-cxx/security/digest-sha256.hpp>
 #include <ndn-cxx/security/signing-helpers.hpp>
 
+#include <boost/functional/hash.hpp>
+
 namespace ndn {
 
 Producer::Producer(Name prefix)
@@ -32,6 +38,8 @@ Producer::Producer(Name prefix)
   , m_dataFreshness(DEFAULT_DATA_FRESHNESS)
   , m_registrationStatus(REGISTRATION_NOT_ATTEMPTED)
   , m_isMakingManifest(false)
+  , m_isMakingManifestTree(false)
+  , m_isParkingInterests(false)
   , m_isWritingToLocalRepo(false)
   , m_repoSocket(m_repoIoService)
   , m_infomaxType(INFOMAX_NONE) // infomax disabled by default
@@ -41,9 +49,14 @@ Producer::Producer(Name prefix)
   , m_infomaxRoot(TreeNode(prefix, 0))
   , m_signatureType(SHA_256)
   , m_keyLocatorSize(DEFAULT_KEY_LOCATOR_SIZE)
-  , m_sendBuffer(DEFAULT_PRODUCER_SND_BUFFER_SIZE)
+  , m_sendBuffer(DEFAULT_PRODUCER_SND_BUFFER_SIZE, DEFAULT_PRODUCER_SND_BUFFER_SHARDS)
   , m_receiveBufferCapacity(DEFAULT_PRODUCER_RCV_BUFFER_SIZE)
-  , m_receiveBufferSize(0)
+  , m_nProcessingThreads(DEFAULT_PRODUCER_PROCESSING_THREADS)
+  , m_interestSharding(SHARD_BY_ADU)
+  , m_maxQueueingDelay(DEFAULT_PRODUCER_MAX_QUEUEING_DELAY)
+  , m_sndBufferExpiryInterval(DEFAULT_PRODUCER_SND_BUFFER_EXPIRY_INTERVAL)
+  , m_sndBufferSnapshotInterval(DEFAULT_PRODUCER_SND_BUFFER_SNAPSHOT_INTERVAL)
+  , m_isSavingSnapshot(false)
   , m_onInterestEntersContext(EMPTY_CALLBACK)
   , m_onInterestDroppedFromRcvBuffer(EMPTY_CALLBACK)
   , m_onInterestPassedRcvBuffer(EMPTY_CALLBACK)
@@ -58,12 +71,31 @@ Producer::Producer(Name prefix)
   m_face = ndn::make_shared<ndn::Face>();
   m_controller = ndn::make_shared<nfd::Controller>(*m_face, m_keyChain);
   m_scheduler = new Scheduler(m_face->getIoService());
+
+  m_sendBuffer.setPolicy(DEFAULT_PRODUCER_SND_BUFFER_POLICY);
+  m_sendBuffer.setEvictionCallback(bind(&Producer::onDataEvicted, this, _1));
+  scheduleExpiry();
 }
 
 Producer::~Producer()
 {
   m_repoSocket.close();
   m_listeningThread.interrupt();
+
+  // processing threads sleep on their receive buffers, so they can be woken up and joined
+  m_processingThreads.interrupt_all();
+  m_processingThreads.join_all();
+
+  stopSigningThreads();
+
+  if (m_snapshotThread.joinable()) {
+    m_snapshotThread.join();
+  }
+
+  if (!m_sndBufferSnapshotPath.empty()) {
+    cs::Snapshot::save(m_sendBuffer, m_sndBufferSnapshotPath);
+  }
+
   delete m_scheduler;
   m_controller.reset();
   m_face.reset();
@@ -72,8 +104,21 @@ Producer::~Producer()
 void
 Producer::attach()
 {
+  if (!m_receiveBuffers.empty()) // already attached
+    return;
+
+  // receive buffer capacity is shared between the processing threads
+  size_t capacityPerThread = (m_receiveBufferCapacity + m_nProcessingThreads - 1) / m_nProcessingThreads;
+
+  for (int i = 0; i < m_nProcessingThreads; i++) {
+    m_receiveBuffers.push_back(make_shared<ReceiveBuffer>(capacityPerThread));
+  }
+
   m_listeningThread = boost::thread(bind(&Producer::listen, this));
-  m_processingThread = boost::thread(bind(&Producer::processIncomingInterest, this));
+
+  for (int i = 0; i < m_nProcessingThreads; i++) {
+    m_processingThreads.create_thread(bind(&Producer::processIncomingInterest, this, m_receiveBuffers[i]));
+  }
 }
 
 void
@@ -116,58 +161,548 @@ Producer::onRegistrationFailed(const ndn::Name& prefix, const std::string& reaso
   m_face->shutdown();
 }
 
-void
+ndn::ConstBufferPtr
 Producer::passSegmentThroughCallbacks(shared_ptr<Data> segment)
 {
-  if (segment) {
-    if (m_onNewSegment != EMPTY_CALLBACK) {
+  bool isSecuredByManifest = m_isMakingManifest && segment && segment->getContentType() != tlv::ContentType_Manifest;
+  return passSegmentThroughCallbacks(segment, isSecuredByManifest);
+}
+
+ndn::ConstBufferPtr
+Producer::passSegmentThroughCallbacks(shared_ptr<Data> segment, bool isSecuredByManifest)
+{
+  if (!segment)
+    return ndn::ConstBufferPtr();
+
+  std::vector<shared_ptr<Data>> segments(1, segment);
+  return passSegmentsThroughCallbacks(segments, isSecuredByManifest, m_keyLocator).front();
+}
+
+// Segments go through the callbacks stage by stage, so that DigestSha256 signatures and
+// implicit digests of the whole batch are computed by one Sha256Batch call.
+std::vector<ndn::ConstBufferPtr>
+Producer::passSegmentsThroughCallbacks(const std::vector<shared_ptr<Data>>& segments,
+                                       bool isSecuredByManifest, const KeyLocator& keyLocator)
+{
+  if (m_onNewSegment != EMPTY_CALLBACK) {
+    for (const shared_ptr<Data>& segment : segments) {
       m_onNewSegment(*this, *segment);
     }
+  }
 
-    if (m_onDataToSecure != EMPTY_CALLBACK) {
-      if (!m_isMakingManifest) {
-        m_onDataToSecure(*this, *segment);
-      }
-      else {
-        if (segment->getContentType() == tlv::ContentType_Manifest) {
-          m_onDataToSecure(*this, *segment);
-        }
-        else {
-          // data's KeyLocator will point to the corresponding manifest
-          ndn::DigestSha256 sig;
-          const SignatureInfo info(tlv::DigestSha256, m_keyLocator);
-          sig.setInfo(info);
-          segment->setSignature(sig);
-
-          Block sigValue(tlv::SignatureValue,
-                         util::Sha256::computeDigest(segment->wireEncode().value(),
-                                                     segment->wireEncode().value_size() - segment->getSignature().getValue().size()));
-          segment->setSignatureValue(sigValue);
-        }
-      }
-    }
-    else // this is for developers who don't care about security
-    {
-      m_keyChain.sign(*segment, signingWithSha256());
+  if (m_onDataToSecure != EMPTY_CALLBACK && !isSecuredByManifest) {
+    for (const shared_ptr<Data>& segment : segments) {
+      m_onDataToSecure(*this, *segment);
     }
+  }
+  else if (isSecuredByManifest) {
+    // data's KeyLocator will point to the corresponding manifest
+    signWithDigestSha256(segments, keyLocator);
+  }
+  else // this is for developers who don't care about security
+  {
+    signWithDigestSha256(segments, KeyLocator());
+  }
+
+  return publishSegments(segments);
+}
 
+// Without the table of pending Interests every produced packet is pushed to the forwarder,
+// which satisfies Interests that are still pending there. With the table, only packets
+// that satisfy parked Interests are sent; the rest waits in the send buffer.
+bool
+Producer::isRequested(const Data& data, const ConstBufferPtr& implicitDigest)
+{
+  if (!m_isParkingInterests) {
+    return true;
+  }
+
+  return m_pendingInterests.satisfy(data, implicitDigest) > 0;
+}
+
+std::vector<ndn::ConstBufferPtr>
+Producer::publishSegments(const std::vector<shared_ptr<Data>>& segments)
+{
+  // the segments are final at this point: encode and hash them once,
+  // the digests are shared by the send buffer and the manifest
+  Sha256Batch implicitDigests;
+  for (const shared_ptr<Data>& segment : segments) {
     if (m_onDataInSndBuffer != EMPTY_CALLBACK) {
       m_onDataInSndBuffer(*this, *segment);
     }
 
-    m_sendBuffer.insert(*segment);
+    implicitDigests.add(segment->wireEncode());
+  }
 
-    if (m_onDataLeavesContext != EMPTY_CALLBACK) {
-      m_onDataLeavesContext(*this, *segment);
-    }
+  std::vector<ndn::ConstBufferPtr> digests = implicitDigests.compute();
+
+  // the segments are in the send buffer before any of them is sent
+  m_sendBuffer.insertBatch(segments, digests);
+
+  for (size_t i = 0; i < segments.size(); i++) {
+    const shared_ptr<Data>& segment = segments[i];
+
+    if (isRequested(*segment, digests[i])) {
+      if (m_onDataLeavesContext != EMPTY_CALLBACK) {
+        m_onDataLeavesContext(*this, *segment);
+      }
 
-    m_face->put(*segment);
+      putData(segment);
+    }
 
     if (m_isWritingToLocalRepo) {
+      boost::lock_guard<boost::mutex> lock(m_repoSocketMutex);
       boost::system::error_code ec;
       m_repoSocket.write_some(boost::asio::buffer(segment->wireEncode().wire(), segment->wireEncode().size()), ec);
     }
   }
+
+  return digests;
+}
+
+void
+Producer::putData(const shared_ptr<const Data>& data)
+{
+  // the handler holds the face, not the producer, which may be destroyed before it runs
+  m_face->getIoService().post(bind(&Producer::putToFace, m_face, data));
+}
+
+void
+Producer::putToFace(const shared_ptr<Face>& face, const shared_ptr<const Data>& data)
+{
+  face->put(*data);
+}
+
+// same result as KeyChain::sign(data, signingWithSha256()),
+// but does not touch KeyChain, so it can be called from several threads at once
+void
+Producer::signWithDigestSha256(const std::vector<shared_ptr<Data>>& segments, const KeyLocator& keyLocator)
+{
+  DigestSha256 sig;
+  if (!keyLocator.empty()) {
+    sig.setInfo(SignatureInfo(tlv::DigestSha256, keyLocator));
+  }
+
+  std::vector<EncodingBuffer> encoders(segments.size());
+  Sha256Batch signedPortions;
+
+  for (size_t i = 0; i < segments.size(); i++) {
+    segments[i]->setSignature(sig);
+    segments[i]->wireEncode(encoders[i], true); // signed portion only
+    signedPortions.add(encoders[i].buf(), encoders[i].size());
+  }
+
+  std::vector<ndn::ConstBufferPtr> signatureValues = signedPortions.compute();
+
+  for (size_t i = 0; i < segments.size(); i++) {
+    segments[i]->wireEncode(encoders[i], Block(tlv::SignatureValue, signatureValues[i]));
+  }
+}
+
+void
+Producer::startSigningThreads(int nThreads)
+{
+  m_ioService.reset();
+  m_ioServiceWork = make_shared<boost::asio::io_service::work>(m_ioService);
+
+  for (int i = 0; i < nThreads; i++) {
+    m_signingThreads.push_back(boost::thread([this] { m_ioService.run(); }));
+  }
+}
+
+void
+Producer::stopSigningThreads()
+{
+  m_ioServiceWork.reset(); // let run() return once the queue is empty
+
+  for (std::vector<boost::thread>::iterator it = m_signingThreads.begin(); it != m_signingThreads.end(); ++it) {
+    it->join();
+  }
+
+  m_signingThreads.clear();
+}
+
+// Segment numbers are assigned to the manifest tree in pre-order, so the root manifest is segment 0
+// and every manifest precedes the manifests and data segments it covers.
+// Data segments and non-root manifests are secured with DigestSha256 (their KeyLocator points
+// to the parent manifest), and only the root manifest passes through DATA_TO_SECURE callback.
+// Returns the total number of produced segments.
+uint64_t
+Producer::produceManifestTree(const Name& name, const uint8_t* buf, size_t bufferSize,
+                              size_t freeSpaceForContent, uint64_t numberOfDataSegments)
+{
+  // estimate how many names fit into one manifest
+  uint64_t maxSegments = 2 * numberOfDataSegments;
+  Name catalogueEntry;
+  catalogueEntry.appendSegment(maxSegments);
+  catalogueEntry.append(name::Component::fromImplicitSha256Digest(make_shared<Buffer>(util::Sha256::DIGEST_SIZE)));
+
+  Name manifestName(name);
+  manifestName.appendSegment(maxSegments);
+
+  size_t freeSpaceForCatalogue = m_dataPacketSize - manifestName.wireEncode().size() - m_keyLocatorSize - DEFAULT_DIGEST_SIZE - DEFAULT_SAFETY_OFFSET;
+  size_t fanout = std::max<size_t>(2, freeSpaceForCatalogue / catalogueEntry.wireEncode().size());
+
+  // shape of the tree: level 0 are leaf manifests, the last level is the root
+  std::vector<uint64_t> levelSizes;
+  levelSizes.push_back((numberOfDataSegments + fanout - 1) / fanout);
+  while (levelSizes.back() > 1) {
+    levelSizes.push_back((levelSizes.back() + fanout - 1) / fanout);
+  }
+
+  // pre-order numbering
+  std::vector<std::vector<uint64_t>> manifestNumbers(levelSizes.size());
+  for (size_t level = 0; level < levelSizes.size(); level++) {
+    manifestNumbers[level].resize(levelSizes[level]);
+  }
+  std::vector<uint64_t> dataNumbers(numberOfDataSegments);
+
+  uint64_t nextSegment = 0;
+  std::function<void(size_t, uint64_t)> assignNumbers = [&](size_t level, uint64_t index) {
+    manifestNumbers[level][index] = nextSegment++;
+
+    uint64_t nChildren = (level == 0) ? numberOfDataSegments : levelSizes[level - 1];
+    for (uint64_t child = index * fanout; child < std::min((index + 1) * fanout, nChildren); child++) {
+      if (level == 0)
+        dataNumbers[child] = nextSegment++;
+      else
+        assignNumbers(level - 1, child);
+    }
+  };
+  assignNumbers(levelSizes.size() - 1, 0);
+
+  uint64_t totalSegments = nextSegment;
+  name::Component finalBlockId = name::Component::fromSegment(totalSegments - 1);
+
+  std::vector<std::vector<shared_ptr<Manifest>>> manifests(levelSizes.size());
+  for (size_t level = 0; level < levelSizes.size(); level++) {
+    for (uint64_t index = 0; index < levelSizes[level]; index++) {
+      Name fullName(name);
+      fullName.appendSegment(manifestNumbers[level][index]);
+
+      shared_ptr<Manifest> manifest = make_shared<Manifest>(fullName);
+      manifest->setFreshnessPeriod(time::milliseconds(m_dataFreshness));
+      manifest->setFinalBlockId(finalBlockId);
+      manifests[level].push_back(manifest);
+    }
+  }
+
+  // data segments are secured by leaf manifests,
+  // children of one manifest are signed and hashed as one batch
+  size_t bytesPackaged = 0;
+  for (uint64_t first = 0; first < numberOfDataSegments; first += fanout) {
+    shared_ptr<Manifest> leaf = manifests[0][first / fanout];
+    std::vector<shared_ptr<Data>> children;
+
+    for (uint64_t i = first; i < std::min<uint64_t>(first + fanout, numberOfDataSegments); i++) {
+      Name fullName(name);
+      fullName.appendSegment(dataNumbers[i]);
+
+      shared_ptr<Data> data = make_shared<Data>(fullName);
+      data->setFreshnessPeriod(time::milliseconds(m_dataFreshness));
+      data->setFinalBlockId(finalBlockId);
+
+      size_t contentSize = (i == numberOfDataSegments - 1) ? bufferSize - bytesPackaged : freeSpaceForContent;
+      data->setContent(&buf[bytesPackaged], contentSize);
+      bytesPackaged += contentSize;
+
+      children.push_back(data);
+    }
+
+    KeyLocator keyLocator(leaf->getName());
+    std::vector<ndn::ConstBufferPtr> implicitDigests = passSegmentsThroughCallbacks(children, true, keyLocator);
+
+    for (size_t i = 0; i < children.size(); i++) {
+      leaf->addNameToCatalogue(children[i]->getName().getSubName(-1, 1), implicitDigests[i]);
+    }
+  }
+
+  // manifests are secured by their parents, bottom-up
+  for (size_t level = 0; level + 1 < manifests.size(); level++) {
+    for (uint64_t first = 0; first < manifests[level].size(); first += fanout) {
+      shared_ptr<Manifest> parent = manifests[level + 1][first / fanout];
+      std::vector<shared_ptr<Data>> children;
+
+      for (uint64_t index = first; index < std::min<uint64_t>(first + fanout, manifests[level].size()); index++) {
+        manifests[level][index]->encode();
+        children.push_back(manifests[level][index]);
+      }
+
+      KeyLocator keyLocator(parent->getName());
+      std::vector<ndn::ConstBufferPtr> implicitDigests = passSegmentsThroughCallbacks(children, true, keyLocator);
+
+      for (size_t i = 0; i < children.size(); i++) {
+        parent->addNameToCatalogue(children[i]->getName().getSubName(-1, 1), implicitDigests[i]);
+      }
+    }
+  }
+
+  shared_ptr<Manifest> root = manifests.back().front();
+  root->encode();
+  passSegmentThroughCallbacks(root, false);
+
+  return totalSegments;
+}
+
+// segments are built, signed and published by the signing threads in no particular order,
+// segment numbers and FinalBlockId are computed upfront
+void
+Producer::produceInParallel(const Name& name, const uint8_t* buf, size_t bufferSize,
+                            size_t freeSpaceForContent, uint64_t numberOfSegments)
+{
+  boost::mutex mutex;
+  boost::condition_variable isFinished;
+  uint64_t nPendingSegments = numberOfSegments;
+  std::exception_ptr error;
+
+  name::Component finalBlockId = name::Component::fromSegment(numberOfSegments - 1);
+
+  for (uint64_t i = 0; i < numberOfSegments; i++) {
+    m_ioService.post([&, i] {
+      try {
+        Name fullName(name);
+        fullName.appendSegment(i);
+
+        shared_ptr<Data> data = make_shared<Data>(fullName);
+        data->setFreshnessPeriod(time::milliseconds(m_dataFreshness));
+        data->setFinalBlockId(finalBlockId);
+
+        size_t offset = i * freeSpaceForContent;
+        if (i == numberOfSegments - 1) // last segment
+          data->setContent(&buf[offset], bufferSize - offset);
+        else
+          data->setContent(&buf[offset], freeSpaceForContent);
+
+        passSegmentThroughCallbacks(data);
+      }
+      catch (...) {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        error = std::current_exception();
+      }
+
+      boost::lock_guard<boost::mutex> lock(mutex);
+      if (--nPendingSegments == 0)
+        isFinished.notify_one();
+    });
+  }
+
+  boost::unique_lock<boost::mutex> lock(mutex);
+  while (nPendingSegments > 0)
+    isFinished.wait(lock);
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+void
+Producer::produceInPlace(const Name& name, const uint8_t* buf, size_t bufferSize,
+                         size_t freeSpaceForContent, uint64_t numberOfSegments)
+{
+  for (uint64_t first = 0; first < numberOfSegments; first += DEFAULT_PRODUCER_ENCODING_BATCH) {
+    uint64_t last = std::min<uint64_t>(first + DEFAULT_PRODUCER_ENCODING_BATCH, numberOfSegments);
+    publishSegments(encodeSegmentsInPlace(name, buf, bufferSize, freeSpaceForContent, numberOfSegments, first, last));
+  }
+}
+
+// Segments are encoded and signed with DigestSha256 straight from buf: the payload is copied
+// only once, into the wire of the segment, instead of first into a Content block
+// (Data::setContent) and then into the wire.
+std::vector<shared_ptr<Data>>
+Producer::encodeSegmentsInPlace(const Name& name, const uint8_t* buf, size_t bufferSize,
+                                size_t freeSpaceForContent, uint64_t numberOfSegments,
+                                uint64_t first, uint64_t last)
+{
+  MetaInfo metaInfo;
+  metaInfo.setFreshnessPeriod(time::milliseconds(m_dataFreshness));
+  metaInfo.setFinalBlockId(name::Component::fromSegment(numberOfSegments - 1));
+
+  DigestSha256 signature;
+  const Block& signatureInfo = signature.getInfo();
+
+  std::vector<EncodingBuffer> encoders(last - first);
+  Sha256Batch signedPortions;
+
+  for (uint64_t i = first; i < last; i++) {
+    EncodingBuffer& encoder = encoders[i - first];
+
+    size_t offset = i * freeSpaceForContent;
+    size_t contentSize = (i == numberOfSegments - 1) ? bufferSize - offset : freeSpaceForContent;
+
+    Name fullName(name);
+    fullName.appendSegment(i);
+
+    // signed portion of the Data packet, fields are prepended in reverse order
+    encoder.prependBlock(signatureInfo);
+    encoding::prependByteArrayBlock(encoder, tlv::Content, &buf[offset], contentSize);
+    metaInfo.wireEncode(encoder);
+    fullName.wireEncode(encoder);
+
+    signedPortions.add(encoder.buf(), encoder.size());
+  }
+
+  std::vector<ndn::ConstBufferPtr> signatureValues = signedPortions.compute();
+
+  std::vector<shared_ptr<Data>> segments;
+  for (size_t i = 0; i < encoders.size(); i++) {
+    shared_ptr<Data> segment = make_shared<Data>();
+    // appends SignatureValue and decodes the packet from the wire
+    segment->wireEncode(encoders[i], Block(tlv::SignatureValue, signatureValues[i]));
+    segments.push_back(segment);
+  }
+
+  return segments;
+}
+
+size_t
+Producer::computeFreeSpaceForContent(const Name& name) const
+{
+  size_t bytesOccupiedByName = name.wireEncode().size();
+  int signatureSize = 32; //SHA_256 as default
+
+  return m_dataPacketSize - bytesOccupiedByName - signatureSize - m_keyLocatorSize - DEFAULT_SAFETY_OFFSET;
+}
+
+bool
+Producer::produceFile(Name suffix, const std::string& path)
+{
+  shared_ptr<MappedAdu> adu = make_shared<MappedAdu>();
+
+  try {
+    adu->file.open(path);
+  }
+  catch (const std::ios_base::failure&) {
+    return false;
+  }
+
+  if (!adu->file.is_open() || adu->file.size() == 0) {
+    return false;
+  }
+
+  Name name(m_prefix);
+  if (!suffix.empty()) {
+    name.append(suffix);
+  }
+
+  adu->freeSpaceForContent = computeFreeSpaceForContent(name);
+  adu->numberOfSegments = (adu->file.size() + adu->freeSpaceForContent - 1) / adu->freeSpaceForContent;
+
+  boost::lock_guard<boost::mutex> lock(m_mappedAdusMutex);
+  m_mappedAdus[name] = adu;
+
+  return true;
+}
+
+size_t
+Producer::persistSendBuffer(const std::string& path)
+{
+  size_t nLoaded = cs::Snapshot::load(m_sendBuffer, path);
+
+  m_sndBufferSnapshotPath = path;
+  scheduleSnapshot();
+
+  return nLoaded;
+}
+
+bool
+Producer::saveSendBuffer(const std::string& path)
+{
+  return cs::Snapshot::save(m_sendBuffer, path);
+}
+
+bool
+Producer::spillSendBuffer(const std::string& path)
+{
+  return m_sendBuffer.setDiskTier(path);
+}
+
+void
+Producer::saveSnapshot()
+{
+  m_sndBufferSnapshotEvent = m_scheduler->scheduleEvent(time::milliseconds(m_sndBufferSnapshotInterval),
+                                                        bind(&Producer::saveSnapshot, this));
+
+  // the scheduler runs on the face thread, which must not wait for the file to be written
+  if (m_isSavingSnapshot.exchange(true))
+    return;
+
+  if (m_snapshotThread.joinable()) {
+    m_snapshotThread.join(); // has finished already
+  }
+
+  std::string path = m_sndBufferSnapshotPath;
+  m_snapshotThread = boost::thread([this, path] {
+    cs::Snapshot::save(m_sendBuffer, path);
+    m_isSavingSnapshot = false;
+  });
+}
+
+void
+Producer::scheduleSnapshot()
+{
+  if (static_cast<bool>(m_sndBufferSnapshotEvent)) {
+    m_scheduler->cancelEvent(m_sndBufferSnapshotEvent);
+    m_sndBufferSnapshotEvent.reset();
+  }
+
+  if (m_sndBufferSnapshotInterval > 0 && !m_sndBufferSnapshotPath.empty()) {
+    m_sndBufferSnapshotEvent = m_scheduler->scheduleEvent(time::milliseconds(m_sndBufferSnapshotInterval),
+                                                          bind(&Producer::saveSnapshot, this));
+  }
+}
+
+// called by processing threads on a send buffer miss; with the table of pending Interests
+// the Interest is parked by then, and publishing the segment satisfies it
+bool
+Producer::produceSegmentOnDemand(const Interest& interest)
+{
+  Name name = interest.getName();
+  if (!name.empty() && name.get(-1).isImplicitSha256Digest()) {
+    name = name.getPrefix(-1);
+  }
+
+  uint64_t segment = 0;
+  if (!name.empty() && name.get(-1).isSegment()) {
+    segment = name.get(-1).toSegment();
+    name = name.getPrefix(-1);
+  }
+
+  shared_ptr<MappedAdu> adu;
+  {
+    boost::lock_guard<boost::mutex> lock(m_mappedAdusMutex);
+    std::map<Name, shared_ptr<MappedAdu>>::iterator it = m_mappedAdus.find(name);
+    if (it == m_mappedAdus.end()) {
+      return false;
+    }
+    adu = it->second;
+  }
+
+  if (segment >= adu->numberOfSegments) {
+    return false;
+  }
+
+  const uint8_t* buf = reinterpret_cast<const uint8_t*>(adu->file.data());
+  size_t bufferSize = adu->file.size();
+
+  if (m_onNewSegment == EMPTY_CALLBACK && m_onDataToSecure == EMPTY_CALLBACK) {
+    publishSegments(encodeSegmentsInPlace(name, buf, bufferSize, adu->freeSpaceForContent,
+                                          adu->numberOfSegments, segment, segment + 1));
+  }
+  else {
+    Name fullName(name);
+    fullName.appendSegment(segment);
+
+    shared_ptr<Data> data = make_shared<Data>(fullName);
+    data->setFreshnessPeriod(time::milliseconds(m_dataFreshness));
+    data->setFinalBlockId(name::Component::fromSegment(adu->numberOfSegments - 1));
+
+    size_t offset = segment * adu->freeSpaceForContent;
+    data->setContent(&buf[offset], std::min(adu->freeSpaceForContent, bufferSize - offset));
+
+    std::vector<shared_ptr<Data>> segments(1, data);
+    passSegmentsThroughCallbacks(segments, false, m_keyLocator);
+  }
+
+  return true;
 }
 
 size_t
@@ -196,13 +731,16 @@ Producer::produce(Data& packet)
 
   m_sendBuffer.insert(packet);
 
-  if (m_onDataLeavesContext != EMPTY_CALLBACK) {
-    m_onDataLeavesContext(*this, packet);
-  }
+  if (isRequested(packet, ConstBufferPtr())) {
+    if (m_onDataLeavesContext != EMPTY_CALLBACK) {
+      m_onDataLeavesContext(*this, packet);
+    }
 
-  m_face->put(packet);
+    putData(make_shared<Data>(packet));
+  }
 
   if (m_isWritingToLocalRepo) {
+    boost::lock_guard<boost::mutex> lock(m_repoSocketMutex);
     boost::system::error_code ec;
     m_repoSocket.write_some(boost::asio::buffer(packet.wireEncode().wire(), packet.wireEncode().size()), ec);
   }
@@ -223,6 +761,16 @@ Producer::produce(Data& packet)
   }
 }
 
+void
+Producer::produce(Name suffix, ConstBufferPtr buffer)
+{
+  if (!buffer)
+    return;
+
+  // buffer stays referenced until all segments are built
+  produce(suffix, buffer->data(), buffer->size());
+}
+
 // this can be called either from the thread of the caller
 // or from the m_listeningThread
 void
@@ -238,12 +786,7 @@ Producer::produce(Name suffix, const uint8_t* buf, size_t bufferSize)
     name.append(suffix);
   }
 
-  Block nameOnWire = name.wireEncode();
-  size_t bytesOccupiedByName = nameOnWire.size();
-
-  int signatureSize = 32; //SHA_256 as default
-
-  int freeSpaceForContent = m_dataPacketSize - bytesOccupiedByName - signatureSize - m_keyLocatorSize - DEFAULT_SAFETY_OFFSET;
+  int freeSpaceForContent = computeFreeSpaceForContent(name);
 
   int numberOfSegments = bufferSize / freeSpaceForContent;
 
@@ -257,7 +800,11 @@ Producer::produce(Name suffix, const uint8_t* buf, size_t bufferSize)
   uint64_t initialSegment = currentSegment;
   uint64_t finalSegment = currentSegment;
 
-  if (m_isMakingManifest) // segmentation with inlined manifests
+  if (m_isMakingManifest && m_isMakingManifestTree) // segmentation with a tree of manifests
+  {
+    finalSegment = produceManifestTree(name, buf, bufferSize, freeSpaceForContent, numberOfSegments);
+  }
+  else if (m_isMakingManifest) // segmentation with inlined manifests
   {
     shared_ptr<Data> dataSegment;
     shared_ptr<Manifest> manifestSegment;
@@ -308,7 +855,7 @@ Producer::produce(Name suffix, const uint8_t* buf, size_t bufferSize)
 
       dataSegment->setFinalBlockId(name::Component::fromSegment(currentSegment + numberOfSegments - packagedSegments - 1));
 
-      passSegmentThroughCallbacks(dataSegment);
+      ndn::ConstBufferPtr implicitDigest = passSegmentThroughCallbacks(dataSegment);
       currentSegment++;
 
       size_t manifestSize = estimateManifestSize(manifestSegment);
@@ -318,9 +865,6 @@ Producer::produce(Name suffix, const uint8_t* buf, size_t bufferSize)
         needManifestSegment = true;
       }
 
-      const Block& block = dataSegment->wireEncode();
-      ndn::ConstBufferPtr implicitDigest = ndn::util::Sha256::computeDigest(block.wire(), block.size());
-
       //add implicit digest to the manifest
       manifestSegment->addNameToCatalogue(dataSegment->getName().getSubName(dataSegment->getName().size() - 1, 1), implicitDigest);
 
@@ -333,6 +877,17 @@ Producer::produce(Name suffix, const uint8_t* buf, size_t bufferSize)
       }
     }
   }
+  else if (m_onNewSegment == EMPTY_CALLBACK && m_onDataToSecure == EMPTY_CALLBACK &&
+           m_signingThreads.empty()) // nobody touches segments before they are signed
+  {
+    produceInPlace(name, buf, bufferSize, freeSpaceForContent, numberOfSegments);
+    finalSegment = numberOfSegments;
+  }
+  else if (!m_signingThreads.empty()) // segmentation and signing on the thread pool
+  {
+    produceInParallel(name, buf, bufferSize, freeSpaceForContent, numberOfSegments);
+    finalSegment = numberOfSegments;
+  }
   else // just normal segmentation
   {
     uint64_t i = 0;
@@ -486,8 +1041,7 @@ Producer::nack(ApplicationNack nack)
     m_onDataLeavesContext(*this, nack);
   }
 
-  //shared_ptr<const Data> dataPtr = nack.shared_from_this();
-  m_face->put(nack);
+  putData(make_shared<Data>(nack));
 
   return 0;
 }
@@ -499,66 +1053,179 @@ Producer::onInterest(const Name& name, const Interest& interest)
     m_onInterestEntersContext(*this, interest);
   }
 
-  if (m_receiveBufferSize >= m_receiveBufferCapacity) {
-    // send Interest NACK
+  ReceiveBuffer& receiveBuffer = *m_receiveBuffers[selectProcessingThread(interest)];
+  size_t capacityPerThread = (m_receiveBufferCapacity + m_receiveBuffers.size() - 1) / m_receiveBuffers.size();
+
+  time::nanoseconds queueingDelay = receiveBuffer.estimateQueueingDelay();
+  bool isOverloaded = receiveBuffer.size() >= capacityPerThread ||
+                      (m_maxQueueingDelay > 0 && queueingDelay > time::milliseconds(m_maxQueueingDelay));
+
+  if (isOverloaded || !receiveBuffer.push(interest.shared_from_this())) {
+    if (m_onInterestDroppedFromRcvBuffer != EMPTY_CALLBACK) {
+      m_onInterestDroppedFromRcvBuffer(*this, interest);
+    }
+
+    // ask the consumer to come back when the queue is drained
+    // instead of letting the Interest time out and be retransmitted into the same overload
+    time::milliseconds retryAfter = time::duration_cast<time::milliseconds>(queueingDelay);
+    if (retryAfter < time::milliseconds(1))
+      retryAfter = time::milliseconds(1);
+    if (retryAfter > interest.getInterestLifetime())
+      retryAfter = interest.getInterestLifetime();
+
+    nackOverload(interest, retryAfter);
+  }
+}
+
+void
+Producer::nackOverload(const Interest& interest, time::milliseconds retryAfter)
+{
+  shared_ptr<ApplicationNack> appNack = make_shared<ApplicationNack>(interest, ApplicationNack::PRODUCER_DELAY);
+  appNack->setDelay(retryAfter.count());
+
+  // same freshness as in nack()
+  appNack->setFreshnessPeriod(time::milliseconds(m_dataFreshness / 10 + 1));
+  appNack->encode();
+
+  signWithDigestSha256(std::vector<shared_ptr<Data>>(1, appNack), KeyLocator());
+
+  if (m_onDataLeavesContext != EMPTY_CALLBACK) {
+    m_onDataLeavesContext(*this, *appNack);
   }
-  else {
-    m_receiveBufferMutex.lock();
-    m_receiveBuffer.push(interest.shared_from_this());
-    m_receiveBufferSize++;
-    m_receiveBufferMutex.unlock();
+
+  putData(appNack);
+}
+
+size_t
+Producer::selectProcessingThread(const Interest& interest) const
+{
+  if (m_receiveBuffers.size() == 1)
+    return 0;
+
+  const Name& name = interest.getName();
+  const Block& nameOnWire = name.wireEncode();
+  const uint8_t* end = nameOnWire.value() + nameOnWire.value_size();
+
+  if (m_interestSharding == SHARD_BY_ADU) {
+    // skip implicit digest and segment number, so all segments of an ADU go to the same thread
+    size_t nComponents = name.size();
+    if (nComponents > 0 && name.get(-1).isImplicitSha256Digest()) {
+      end -= name.get(-1).size();
+      nComponents--;
+    }
+
+    if (nComponents > 0 && name.get(nComponents - 1).isSegment()) {
+      end -= name.get(nComponents - 1).size();
+    }
   }
+
+  return boost::hash_range(nameOnWire.value(), end) % m_receiveBuffers.size();
 }
 
-void Producer::processIncomingInterest(/*const Name& name, const Interest& interest*/)
+void
+Producer::processIncomingInterest(shared_ptr<ReceiveBuffer> receiveBuffer)
 {
+  std::vector<shared_ptr<const Interest>> batch;
+  batch.reserve(DEFAULT_PRODUCER_RCV_BATCH_SIZE);
+
   while (true) {
-    if (m_receiveBufferSize == 0) {
-      struct timespec ts;
-      ts.tv_sec = 0;
-      ts.tv_nsec = 1000000;
-      nanosleep(&ts, NULL); // sleep for 1 ms
+    // sleeps until Interests arrive, then takes as many as possible in one go
+    receiveBuffer->waitAndPopBatch(batch, DEFAULT_PRODUCER_RCV_BATCH_SIZE);
+
+    time::steady_clock::TimePoint start = time::steady_clock::now();
+
+    for (std::vector<shared_ptr<const Interest>>::iterator it = batch.begin(); it != batch.end(); ++it) {
+      processInterestFromReceiveBuffer(**it);
     }
-    else {
-      m_receiveBufferMutex.lock();
-      shared_ptr<const Interest> interest = m_receiveBuffer.front();
-      m_receiveBuffer.pop();
-      m_receiveBufferSize--;
-      m_receiveBufferMutex.unlock();
-
-      /*if (m_onInterestToVerify != EMPTY_CALLBACK)
-      {
-        if (m_onInterestToVerify(const_cast<Interest&>(interest)) == false)
-        {
-          // produceNACK
-        }
-      }*/
 
-      const Data* data = m_sendBuffer.find(*interest);
-      if ((Data*)data != 0) {
-        if (m_onInterestSatisfiedFromSndBuffer != EMPTY_CALLBACK) {
-          m_onInterestSatisfiedFromSndBuffer(*this, *interest);
-        }
+    // service rate, used to estimate queueing delay for admission control
+    receiveBuffer->updateServiceTime(batch.size(), time::steady_clock::now() - start);
 
-        if (m_onDataLeavesContext != EMPTY_CALLBACK) {
-          m_onDataLeavesContext(*this, *const_cast<Data*>(data));
-        }
+    batch.clear();
+  }
+}
 
-        m_face->put(*data);
-      }
-      else {
-        if (m_onInterestProcess != EMPTY_CALLBACK) {
-          m_onInterestProcess(*this, *interest);
-        }
+void
+Producer::processInterestFromReceiveBuffer(const Interest& interest)
+{
+  /*if (m_onInterestToVerify != EMPTY_CALLBACK)
+  {
+    if (m_onInterestToVerify(const_cast<Interest&>(interest)) == false)
+    {
+      // produceNACK
+    }
+  }*/
+
+  // holds the packet even if a concurrent produce() evicts it from the send buffer
+  shared_ptr<const Data> data = m_sendBuffer.find(interest);
+
+  if (static_cast<bool>(data)) {
+    if (m_onInterestSatisfiedFromSndBuffer != EMPTY_CALLBACK) {
+      m_onInterestSatisfiedFromSndBuffer(*this, interest);
+    }
+
+    if (m_onDataLeavesContext != EMPTY_CALLBACK) {
+      m_onDataLeavesContext(*this, const_cast<Data&>(*data));
+    }
+
+    putData(data);
+    return;
+  }
+
+  // parked before a segment is produced on demand, so that publishing the segment satisfies it;
+  // a full table remembers the name only, which is enough to send the Data
+  if (m_isParkingInterests) {
+    m_pendingInterests.insert(interest);
+
+    // the Data could be produced between the lookup and the parking
+    data = m_sendBuffer.find(interest);
+    if (static_cast<bool>(data)) {
+      if (m_pendingInterests.satisfy(*data) > 0) {
+        putData(data);
       }
+      return;
     }
   }
+
+  if (produceSegmentOnDemand(interest)) {
+    return; // the segment was built from a mapped file and published like any produced segment
+  }
+
+  if (m_onInterestProcess != EMPTY_CALLBACK) {
+    m_onInterestProcess(*this, interest);
+  }
 }
 
 void
-Producer::processInterestFromReceiveBuffer()
+Producer::onDataEvicted(const Data& data)
 {
-  // put stuff here
+  if (m_onDataEvictedFromSndBuffer != EMPTY_CALLBACK) {
+    m_onDataEvictedFromSndBuffer(*this, const_cast<Data&>(data));
+  }
+}
+
+void
+Producer::removeExpiredData()
+{
+  m_sndBufferExpiryEvent = m_scheduler->scheduleEvent(time::milliseconds(m_sndBufferExpiryInterval),
+                                                      bind(&Producer::removeExpiredData, this));
+  m_sendBuffer.removeExpired();
+}
+
+void
+Producer::scheduleExpiry()
+{
+  if (static_cast<bool>(m_sndBufferExpiryEvent)) {
+    m_scheduler->cancelEvent(m_sndBufferExpiryEvent);
+    m_sndBufferExpiryEvent.reset();
+  }
+
+  m_sendBuffer.setExpiry(m_sndBufferExpiryInterval > 0);
+
+  if (m_sndBufferExpiryInterval > 0) {
+    m_sndBufferExpiryEvent = m_scheduler->scheduleEvent(time::milliseconds(m_sndBufferExpiryInterval),
+                                                        bind(&Producer::removeExpiredData, this));
+  }
 }
 
 int
@@ -592,10 +1259,88 @@ Producer::setContextOption(int optionName, int optionValue)
         return OPTION_VALUE_NOT_SET;
       }
 
+    case SND_BUF_POLICY:
+      if (m_sendBuffer.setPolicy(optionValue)) {
+        return OPTION_VALUE_SET;
+      }
+      else {
+        return OPTION_VALUE_NOT_SET;
+      }
+
     case DATA_FRESHNESS:
       m_dataFreshness = optionValue;
       return OPTION_VALUE_SET;
 
+    case PROCESSING_THREADS:
+      // the number of threads is fixed once the context is attached
+      if (optionValue >= 1 && m_receiveBuffers.empty()) {
+        m_nProcessingThreads = optionValue;
+        return OPTION_VALUE_SET;
+      }
+      else {
+        return OPTION_VALUE_NOT_SET;
+      }
+
+    case INTEREST_SHARDING:
+      if (optionValue == SHARD_BY_ADU || optionValue == SHARD_BY_NAME) {
+        m_interestSharding = optionValue;
+        return OPTION_VALUE_SET;
+      }
+      else {
+        return OPTION_VALUE_NOT_SET;
+      }
+
+    case MAX_QUEUEING_DELAY:
+      if (optionValue >= 0) {
+        m_maxQueueingDelay = optionValue;
+        return OPTION_VALUE_SET;
+      }
+      else {
+        return OPTION_VALUE_NOT_SET;
+      }
+
+    case SND_BUF_EXPIRY_INTERVAL:
+      if (optionValue >= 0) {
+        m_sndBufferExpiryInterval = optionValue;
+        scheduleExpiry();
+        return OPTION_VALUE_SET;
+      }
+      else {
+        return OPTION_VALUE_NOT_SET;
+      }
+
+    case SND_BUF_SNAPSHOT_INTERVAL:
+      if (optionValue >= 0) {
+        m_sndBufferSnapshotInterval = optionValue;
+        scheduleSnapshot();
+        return OPTION_VALUE_SET;
+      }
+      else {
+        return OPTION_VALUE_NOT_SET;
+      }
+
+    case PENDING_INTERESTS_SIZE:
+      if (optionValue > 0) {
+        m_pendingInterests.setLimit(optionValue);
+        return OPTION_VALUE_SET;
+      }
+      else {
+        return OPTION_VALUE_NOT_SET;
+      }
+
+    case SIGNING_THREADS:
+      // must not be changed while produce() is running
+      if (optionValue >= 0) {
+        stopSigningThreads();
+        if (optionValue > 0) {
+          startSigningThreads(optionValue);
+        }
+        return OPTION_VALUE_SET;
+      }
+      else {
+        return OPTION_VALUE_NOT_SET;
+      }
+
     case SIGNATURE_TYPE:
       if (optionValue == OPTION_DEFAULT_VALUE)
         m_signatureType = SHA_256;
@@ -687,6 +1432,14 @@ Producer::setContextOption(int optionName, bool optionValue)
       m_isMakingManifest = optionValue;
       return OPTION_VALUE_SET;
 
+    case MANIFEST_TREE:
+      m_isMakingManifestTree = optionValue;
+      return OPTION_VALUE_SET;
+
+    case PENDING_INTERESTS:
+      m_isParkingInterests = optionValue;
+      return OPTION_VALUE_SET;
+
     case LOCAL_REPO:
 
       if (optionValue == true) {
@@ -878,6 +1631,10 @@ Producer::getContextOption(int optionName, int& optionValue)
       optionValue = m_sendBuffer.getLimit();
       return OPTION_FOUND;
 
+    case SND_BUF_POLICY:
+      optionValue = m_sendBuffer.getPolicy();
+      return OPTION_FOUND;
+
     case DATA_PKT_SIZE:
       optionValue = m_dataPacketSize;
       return OPTION_FOUND;
@@ -886,6 +1643,34 @@ Producer::getContextOption(int optionName, int& optionValue)
       optionValue = m_dataFreshness;
       return OPTION_FOUND;
 
+    case PROCESSING_THREADS:
+      optionValue = m_nProcessingThreads;
+      return OPTION_FOUND;
+
+    case INTEREST_SHARDING:
+      optionValue = m_interestSharding;
+      return OPTION_FOUND;
+
+    case SIGNING_THREADS:
+      optionValue = m_signingThreads.size();
+      return OPTION_FOUND;
+
+    case PENDING_INTERESTS_SIZE:
+      optionValue = m_pendingInterests.getLimit();
+      return OPTION_FOUND;
+
+    case MAX_QUEUEING_DELAY:
+      optionValue = m_maxQueueingDelay;
+      return OPTION_FOUND;
+
+    case SND_BUF_EXPIRY_INTERVAL:
+      optionValue = m_sndBufferExpiryInterval;
+      return OPTION_FOUND;
+
+    case SND_BUF_SNAPSHOT_INTERVAL:
+      optionValue = m_sndBufferSnapshotInterval;
+      return OPTION_FOUND;
+
     case SIGNATURE_TYPE:
       optionValue = m_signatureType;
       return OPTION_FOUND;
@@ -915,6 +1700,14 @@ Producer::getContextOption(int optionName, bool& optionValue)
       optionValue = m_isMakingManifest;
       return OPTION_FOUND;
 
+    case MANIFEST_TREE:
+      optionValue = m_isMakingManifestTree;
+      return OPTION_FOUND;
+
+    case PENDING_INTERESTS:
+      optionValue = m_isParkingInterests;
+      return OPTION_FOUND;
+
     case LOCAL_REPO:
       optionValue = m_isWritingToLocalRepo;
       return OPTION_FOUND;
@@ -1053,6 +1846,14 @@ int
 Producer::setContextOption(int optionName, size_t optionValue)
 {
   switch (optionName) {
+    case SND_BUF_BYTE_LIMIT:
+      m_sendBuffer.setByteLimit(optionValue);
+      return OPTION_VALUE_SET;
+
+    case SND_BUF_DISK_BYTE_LIMIT:
+      m_sendBuffer.getDiskTier().setByteLimit(optionValue);
+      return OPTION_VALUE_SET;
+
     case RCV_BUF_SIZE:
       if (m_receiveBufferCapacity >= 1) {
         m_receiveBufferCapacity = optionValue;
@@ -1076,6 +1877,43 @@ Producer::getContextOption(int optionName, size_t& optionValue)
       optionValue = m_sendBuffer.size();
       return OPTION_FOUND;
 
+    // hit ratio of the send buffer is SND_BUF_HITS / (SND_BUF_HITS + SND_BUF_MISSES)
+    case SND_BUF_HITS:
+      optionValue = m_sendBuffer.getNHits();
+      return OPTION_FOUND;
+
+    case SND_BUF_MISSES:
+      optionValue = m_sendBuffer.getNMisses();
+      return OPTION_FOUND;
+
+    case SND_BUF_EVICTIONS:
+      optionValue = m_sendBuffer.getNEvictions();
+      return OPTION_FOUND;
+
+    case SND_BUF_EXPIRATIONS:
+      optionValue = m_sendBuffer.getNExpirations();
+      return OPTION_FOUND;
+
+    case SND_BUF_BYTE_LIMIT:
+      optionValue = m_sendBuffer.getByteLimit();
+      return OPTION_FOUND;
+
+    case SND_BUF_BYTES:
+      optionValue = m_sendBuffer.getNBytes();
+      return OPTION_FOUND;
+
+    case SND_BUF_DISK_BYTE_LIMIT:
+      optionValue = m_sendBuffer.getDiskTier().getByteLimit();
+      return OPTION_FOUND;
+
+    case SND_BUF_DISK_BYTES:
+      optionValue = m_sendBuffer.getDiskTier().getNBytes();
+      return OPTION_FOUND;
+
+    case SND_BUF_DISK_HITS:
+      optionValue = m_sendBuffer.getDiskTier().getNHits();
+      return OPTION_FOUND;
+
     default:
       return OPTION_NOT_FOUND;
   }
@@ -29,6 +29,8 @@
 #include "cs.hpp"
 #include "infomax-prioritizer.hpp"
 #include "infomax-tree-node.hpp"
+#include "pit.hpp"
+#include "receive-buffer.hpp"
 #include "repo-command-parameter.hpp"
 
 #include <ndn-cxx/mgmt/nfd/controller.hpp>
@@ -38,13 +40,10 @@
 
 #include <boost/asio.hpp>
 #include <boost/atomic.hpp>
-#include <boost/lockfree/queue.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/mutex.hpp>
 
-#include <queue>
-#include <time.h> // for nanosleep
-
 namespace ndn {
 class Prioritizer;
 /**
@@ -88,12 +87,80 @@ public:
    * @param buffer Memory buffer storing Application Data Unit (ADU)
    * @param bufferSize Size of the supplied memory buffer
    *
+   * If SIGNING_THREADS is set, segments are built and signed on a thread pool and published
+   * as soon as they are signed, so NEW_DATA_SEGMENT, DATA_TO_SECURE, DATA_IN_SND_BUF and
+   * DATA_LEAVE_CNTX callbacks can be called concurrently from several threads.
+   *
    * @return The number of produced Data packets or -1 if the supplied ADU requires
    * more Data segments than it is possible to store in the output buffer.
    */
   void
   produce(Name suffix, const uint8_t* buffer, size_t bufferSize);
 
+  /**
+   * @brief Performs segmentation of a reference-counted memory buffer into Data packets.
+   * Same as produce(suffix, buffer->data(), buffer->size()), but the caller does not have
+   * to keep the buffer alive: the producer holds a reference while segments are built.
+   *
+   * Unless NEW_DATA_SEGMENT or DATA_TO_SECURE callbacks are set (or manifests are made),
+   * segments are encoded straight from slices of the buffer, so the payload is copied
+   * only once, into the wire of each segment.
+   */
+  void
+  produce(Name suffix, ConstBufferPtr buffer);
+
+  /**
+   * @brief Publishes a file as Application Data Unit (ADU) without reading it into memory.
+   * The file is memory-mapped and the number of segments is computed from DATA_PKT_SIZE,
+   * but segments are built and signed only when Interests for them arrive, and then
+   * cached in the output buffer. Producing the same suffix again replaces the mapping.
+   *
+   * Manifests (FAST_SIGNING) and writing into the Repo are not supported for mapped files.
+   *
+   * @param suffix Name components that identify the boundary of Application Data Unit (ADU)
+   * @param path Path to the file
+   * @return false if the file cannot be mapped or is empty
+   */
+  bool
+  produceFile(Name suffix, const std::string& path);
+
+  /**
+   * @brief Loads the output buffer from a snapshot file and keeps the snapshot up to date.
+   * Signed segments saved by a previous run are served at once, without producing them again;
+   * segments that became stale in the meantime are dropped. The output buffer is saved into
+   * the file when the producer is destroyed, and every SND_BUF_SNAPSHOT_INTERVAL milliseconds
+   * if the option is set.
+   *
+   * @param path Path to the snapshot file, it does not have to exist yet
+   * @return The number of loaded Data packets
+   */
+  size_t
+  persistSendBuffer(const std::string& path);
+
+  /**
+   * @brief Saves the output buffer into a snapshot file that persistSendBuffer() can load.
+   *
+   * @param path Path to the snapshot file
+   * @return false if the file cannot be written
+   */
+  bool
+  saveSendBuffer(const std::string& path);
+
+  /**
+   * @brief Extends the output buffer with a log file on disk.
+   * Data packets evicted from the output buffer are appended to the file, and Interests
+   * for exact names that miss in memory are satisfied from it, without producing and
+   * signing the packets again. The size of the file is limited by SND_BUF_DISK_BYTE_LIMIT.
+   * The file is removed when the producer is destroyed.
+   *
+   * Should be called before the producer is attached.
+   *
+   * @param path Path to the log file, an existing file is overwritten; empty path disables the log
+   * @return false if the file cannot be created
+   */
+  bool
+  spillSendBuffer(const std::string& path);
+
   void
   produce(Data& packet);
 
@@ -221,7 +288,8 @@ public:
 private:
   // context inner state variables
   ndn::shared_ptr<ndn::Face> m_face;
-  boost::asio::io_service m_ioService;
+  boost::asio::io_service m_ioService; // runs segmentation and signing tasks (see SIGNING_THREADS)
+  shared_ptr<boost::asio::io_service::work> m_ioServiceWork;
   shared_ptr<nfd::Controller> m_controller;
   Scheduler* m_scheduler;
 
@@ -234,11 +302,14 @@ private:
   int m_registrationStatus;
 
   bool m_isMakingManifest;
+  bool m_isMakingManifestTree;
+  bool m_isParkingInterests;
 
   // repo related stuff
   bool m_isWritingToLocalRepo;
   boost::asio::io_service m_repoIoService;
   boost::asio::ip::tcp::socket m_repoSocket;
+  boost::mutex m_repoSocketMutex;
 
   // infomax related stuff
   uint64_t m_infomaxTreeVersion;
@@ -257,15 +328,35 @@ private:
   // buffers
   Cs m_sendBuffer;
 
-  //boost::lockfree::queue<shared_ptr<const Interest> >m_receiveBuffer{DEFAULT_PRODUCER_RCV_BUFFER_SIZE};
-  std::queue<shared_ptr<const Interest>> m_receiveBuffer;
-  boost::mutex m_receiveBufferMutex;
+  struct MappedAdu
+  {
+    boost::iostreams::mapped_file_source file;
+    size_t freeSpaceForContent;
+    uint64_t numberOfSegments;
+  };
+
+  Pit m_pendingInterests; // Interests waiting for Data that is not produced yet
+
+  std::map<Name, shared_ptr<MappedAdu>> m_mappedAdus; // published with produceFile(), by ADU name
+  boost::mutex m_mappedAdusMutex;
+
+  std::vector<shared_ptr<ReceiveBuffer>> m_receiveBuffers; // one per processing thread
   boost::atomic_size_t m_receiveBufferCapacity;
-  boost::atomic_size_t m_receiveBufferSize;
 
   // threads
   boost::thread m_listeningThread;
-  boost::thread m_processingThread;
+  boost::thread_group m_processingThreads;
+  int m_nProcessingThreads;
+  int m_interestSharding;
+  int m_maxQueueingDelay; // milliseconds, 0 means that only a full receive buffer rejects Interests
+  int m_sndBufferExpiryInterval; // milliseconds, 0 means that stale Data is not removed
+  EventId m_sndBufferExpiryEvent;
+  std::string m_sndBufferSnapshotPath; // empty if the send buffer is not persisted
+  int m_sndBufferSnapshotInterval;     // milliseconds, 0 means that it is saved only on destruction
+  EventId m_sndBufferSnapshotEvent;
+  boost::thread m_snapshotThread;          // writes periodic snapshots away from the face thread
+  boost::atomic<bool> m_isSavingSnapshot;  // a periodic snapshot is being written
+  std::vector<boost::thread> m_signingThreads;
 
   // user-defined callbacks
   ProducerInterestCallback m_onInterestEntersContext;
@@ -296,14 +387,125 @@ private:
   void
   onRegistrationFailed(const ndn::Name& prefix, const std::string& reason);
 
-  void processIncomingInterest(/*const Name& name, const Interest& interest*/);
+  void
+  processIncomingInterest(shared_ptr<ReceiveBuffer> receiveBuffer);
+
+  size_t
+  selectProcessingThread(const Interest& interest) const;
+
+  /** \brief asks the consumer to retry the Interest later, when the receive buffer is full
+   *  The NACK is signed with DigestSha256, so that overload does not make the listening
+   *  thread sign with the key of the application.
+   */
+  void
+  nackOverload(const Interest& interest, time::milliseconds retryAfter);
 
   void
-  processInterestFromReceiveBuffer();
+  processInterestFromReceiveBuffer(const Interest& interest);
 
+  /** \brief called by the send buffer for every packet evicted by its replacement policy
+   *  or removed because it became stale
+   */
+  void
+  onDataEvicted(const Data& data);
+
+  /** \brief removes stale Data from the send buffer, repeats every m_sndBufferExpiryInterval
+   */
   void
+  removeExpiredData();
+
+  /** \brief (re)starts or stops the periodic removal of stale Data
+   */
+  void
+  scheduleExpiry();
+
+  /** \brief saves the send buffer into its snapshot, repeats every m_sndBufferSnapshotInterval
+   *  The file is written by m_snapshotThread; a save is skipped while the previous one runs.
+   */
+  void
+  saveSnapshot();
+
+  /** \brief (re)starts or stops the periodic saving of the send buffer
+   */
+  void
+  scheduleSnapshot();
+
+  /** \brief signs the segment, places it into the send buffer and sends it out
+   *  \return{ implicit SHA-256 digest of the segment }
+   */
+  ndn::ConstBufferPtr
   passSegmentThroughCallbacks(shared_ptr<Data> segment);
 
+  ndn::ConstBufferPtr
+  passSegmentThroughCallbacks(shared_ptr<Data> segment, bool isSecuredByManifest);
+
+  /** \brief same as passSegmentThroughCallbacks, but signs and hashes the segments as a batch
+   *  \param keyLocator name of the manifest that secures the segments (used if isSecuredByManifest)
+   *  \return{ implicit SHA-256 digests of the segments }
+   */
+  std::vector<ndn::ConstBufferPtr>
+  passSegmentsThroughCallbacks(const std::vector<shared_ptr<Data>>& segments,
+                               bool isSecuredByManifest, const KeyLocator& keyLocator);
+
+  uint64_t
+  produceManifestTree(const Name& name, const uint8_t* buf, size_t bufferSize,
+                      size_t freeSpaceForContent, uint64_t numberOfDataSegments);
+
+  void
+  produceInParallel(const Name& name, const uint8_t* buf, size_t bufferSize,
+                    size_t freeSpaceForContent, uint64_t numberOfSegments);
+
+  void
+  produceInPlace(const Name& name, const uint8_t* buf, size_t bufferSize,
+                 size_t freeSpaceForContent, uint64_t numberOfSegments);
+
+  /** \brief builds segments [first, last) of an ADU signed with DigestSha256
+   */
+  std::vector<shared_ptr<Data>>
+  encodeSegmentsInPlace(const Name& name, const uint8_t* buf, size_t bufferSize,
+                        size_t freeSpaceForContent, uint64_t numberOfSegments,
+                        uint64_t first, uint64_t last);
+
+  size_t
+  computeFreeSpaceForContent(const Name& name) const;
+
+  /** \brief builds the segment requested by the Interest from a mapped file
+   *  \return{ false if the Interest does not ask for a segment of a mapped file }
+   */
+  bool
+  produceSegmentOnDemand(const Interest& interest);
+
+  /** \brief satisfies parked Interests with the Data
+   *  \return{ whether the Data has to be sent out }
+   */
+  bool
+  isRequested(const Data& data, const ConstBufferPtr& implicitDigest);
+
+  /** \brief sends the Data out from the thread that runs the face
+   *  ndn::Face is not thread-safe, while packets are sent by processing threads,
+   *  the signing pool and the application.
+   */
+  void
+  putData(const shared_ptr<const Data>& data);
+
+  static void
+  putToFace(const shared_ptr<Face>& face, const shared_ptr<const Data>& data);
+
+  /** \brief places signed segments into the send buffer and sends them out
+   *  \return{ implicit SHA-256 digests of the segments }
+   */
+  std::vector<ndn::ConstBufferPtr>
+  publishSegments(const std::vector<shared_ptr<Data>>& segments);
+
+  void
+  signWithDigestSha256(const std::vector<shared_ptr<Data>>& segments, const KeyLocator& keyLocator);
+
+  void
+  startSigningThreads(int nThreads);
+
+  void
+  stopSigningThreads();
+
   size_t
   estimateManifestSize(shared_ptr<Manifest> manifest);
 
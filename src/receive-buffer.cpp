@@ -0,0 +1,204 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+#include "receive-buffer.hpp"
+
+namespace ndn {
+
+ReceiveBuffer::ReceiveBuffer(size_t capacity)
+  : m_cells(0)
+  , m_mask(0)
+  , m_enqueuePosition(0)
+  , m_dequeuePosition(0)
+  , m_size(0)
+  , m_serviceTime(0)
+  , m_isConsumerWaiting(false)
+{
+  allocate(capacity);
+}
+
+ReceiveBuffer::~ReceiveBuffer()
+{
+  release();
+}
+
+void
+ReceiveBuffer::allocate(size_t capacity)
+{
+  // the ring needs at least two cells, and its size must be a power of two
+  size_t nCells = 2;
+  while (nCells < capacity)
+    nCells <<= 1;
+
+  m_cells = new Cell[nCells];
+  m_mask = nCells - 1;
+
+  for (size_t i = 0; i < nCells; i++)
+    m_cells[i].sequence.store(i, boost::memory_order_relaxed);
+
+  m_enqueuePosition.store(0, boost::memory_order_relaxed);
+  m_dequeuePosition = 0;
+  m_size.store(0, boost::memory_order_relaxed);
+}
+
+void
+ReceiveBuffer::release()
+{
+  delete[] m_cells;
+  m_cells = 0;
+  m_mask = 0;
+}
+
+void
+ReceiveBuffer::setCapacity(size_t capacity)
+{
+  release();
+  allocate(capacity);
+}
+
+size_t
+ReceiveBuffer::getCapacity() const
+{
+  return m_mask + 1;
+}
+
+size_t
+ReceiveBuffer::size() const
+{
+  return m_size.load(boost::memory_order_relaxed);
+}
+
+void
+ReceiveBuffer::updateServiceTime(size_t nInterests, time::nanoseconds elapsed)
+{
+  if (nInterests == 0)
+    return;
+
+  uint64_t sample = static_cast<uint64_t>(elapsed.count()) / nInterests;
+  uint64_t average = m_serviceTime.load(boost::memory_order_relaxed);
+
+  // exponentially weighted moving average with alpha = 1/8, as in RTT estimation
+  if (average == 0)
+    average = sample;
+  else
+    average = average - average / 8 + sample / 8;
+
+  m_serviceTime.store(average, boost::memory_order_relaxed);
+}
+
+time::nanoseconds
+ReceiveBuffer::estimateQueueingDelay() const
+{
+  return time::nanoseconds(size() * m_serviceTime.load(boost::memory_order_relaxed));
+}
+
+bool
+ReceiveBuffer::push(const shared_ptr<const Interest>& interest)
+{
+  Cell* cell = 0;
+  size_t position = m_enqueuePosition.load(boost::memory_order_relaxed);
+
+  // claim a free cell
+  while (true) {
+    cell = &m_cells[position & m_mask];
+    size_t sequence = cell->sequence.load(boost::memory_order_acquire);
+    intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+    if (difference == 0) {
+      if (m_enqueuePosition.compare_exchange_weak(position, position + 1, boost::memory_order_relaxed))
+        break;
+    }
+    else if (difference < 0) {
+      return false; // ring is full
+    }
+    else {
+      position = m_enqueuePosition.load(boost::memory_order_relaxed);
+    }
+  }
+
+  m_size.fetch_add(1, boost::memory_order_relaxed);
+
+  cell->interest = interest;
+  cell->sequence.store(position + 1, boost::memory_order_release); // publish to the consumer
+
+  // pairs with the fence in waitAndPopBatch(): either the consumer sees the new Interest,
+  // or we see that the consumer went to sleep
+  boost::atomic_thread_fence(boost::memory_order_seq_cst);
+  if (m_isConsumerWaiting.load(boost::memory_order_relaxed)) {
+    boost::lock_guard<boost::mutex> lock(m_wakeupMutex);
+    m_wakeupCondition.notify_one();
+  }
+
+  return true;
+}
+
+size_t
+ReceiveBuffer::popBatch(std::vector<shared_ptr<const Interest>>& batch, size_t maxBatchSize)
+{
+  size_t nPopped = 0;
+
+  while (nPopped < maxBatchSize) {
+    Cell& cell = m_cells[m_dequeuePosition & m_mask];
+    size_t sequence = cell.sequence.load(boost::memory_order_acquire);
+
+    if (sequence != m_dequeuePosition + 1)
+      break; // ring is empty (or the next cell is not published yet)
+
+    batch.push_back(cell.interest);
+    cell.interest.reset();
+
+    // return the cell to the producers for the next lap
+    cell.sequence.store(m_dequeuePosition + m_mask + 1, boost::memory_order_release);
+    m_dequeuePosition++;
+    nPopped++;
+  }
+
+  if (nPopped > 0)
+    m_size.fetch_sub(nPopped, boost::memory_order_relaxed);
+
+  return nPopped;
+}
+
+size_t
+ReceiveBuffer::waitAndPopBatch(std::vector<shared_ptr<const Interest>>& batch, size_t maxBatchSize)
+{
+  size_t nPopped = popBatch(batch, maxBatchSize);
+
+  while (nPopped == 0) {
+    boost::unique_lock<boost::mutex> lock(m_wakeupMutex);
+
+    m_isConsumerWaiting.store(true, boost::memory_order_relaxed);
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+    // check again, because an Interest could arrive before we announced that we sleep
+    nPopped = popBatch(batch, maxBatchSize);
+    if (nPopped == 0) {
+      m_wakeupCondition.wait(lock); // interruption point
+      nPopped = popBatch(batch, maxBatchSize);
+    }
+
+    m_isConsumerWaiting.store(false, boost::memory_order_relaxed);
+  }
+
+  return nPopped;
+}
+
+} // namespace ndn
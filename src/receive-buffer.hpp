@@ -0,0 +1,132 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+#ifndef RECEIVE_BUFFER_HPP
+#define RECEIVE_BUFFER_HPP
+
+#include "common.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <vector>
+
+namespace ndn {
+
+/** \brief represents the receive buffer of a producer context
+ *
+ *  Bounded multi-producer/single-consumer ring of Interests.
+ *  push() is lock-free and never blocks; the consumer drains the ring in batches
+ *  and sleeps on a condition variable when there is nothing to process.
+ *  The mutex is taken only to park or to wake up a sleeping consumer.
+ *
+ *  Reference: "Bounded MPMC queue" by D.Vyukov
+ */
+class ReceiveBuffer : noncopyable
+{
+public:
+  explicit ReceiveBuffer(size_t capacity);
+
+  ~ReceiveBuffer();
+
+  /** \brief places an Interest into the ring and wakes up the consumer if it sleeps
+   *  Can be called from any thread.
+   *  \return{ false if the ring is full and the Interest was not placed }
+   */
+  bool
+  push(const shared_ptr<const Interest>& interest);
+
+  /** \brief moves up to maxBatchSize Interests from the ring into batch
+   *  Blocks until at least one Interest is available.
+   *  Must be called only from the consumer thread. It is a boost::thread interruption point.
+   *  \return{ number of Interests appended to batch }
+   */
+  size_t
+  waitAndPopBatch(std::vector<shared_ptr<const Interest>>& batch, size_t maxBatchSize);
+
+  /** \brief moves up to maxBatchSize Interests from the ring into batch without blocking
+   *  Must be called only from the consumer thread.
+   *  \return{ number of Interests appended to batch }
+   */
+  size_t
+  popBatch(std::vector<shared_ptr<const Interest>>& batch, size_t maxBatchSize);
+
+  /** \brief changes the number of slots in the ring
+   *  Must not be called while other threads push to or pop from the ring.
+   *  Interests that are already buffered are discarded.
+   */
+  void
+  setCapacity(size_t capacity);
+
+  /** \brief returns the number of slots in the ring (capacity rounded up to the power of two)
+   */
+  size_t
+  getCapacity() const;
+
+  /** \brief returns approximate number of Interests waiting in the ring
+   */
+  size_t
+  size() const;
+
+  /** \brief updates the average time the consumer spends on one Interest
+   *  Must be called only from the consumer thread.
+   */
+  void
+  updateServiceTime(size_t nInterests, time::nanoseconds elapsed);
+
+  /** \brief returns how long a newly pushed Interest would wait in the ring,
+   *  estimated from the number of waiting Interests and the average service time
+   */
+  time::nanoseconds
+  estimateQueueingDelay() const;
+
+private:
+  struct Cell
+  {
+    boost::atomic<size_t> sequence;
+    shared_ptr<const Interest> interest;
+  };
+
+  void
+  allocate(size_t capacity);
+
+  void
+  release();
+
+private:
+  Cell* m_cells;
+  size_t m_mask;
+
+  boost::atomic<size_t> m_enqueuePosition;
+  size_t m_dequeuePosition; // owned by the consumer
+  boost::atomic<size_t> m_size;
+  boost::atomic<uint64_t> m_serviceTime; // nanoseconds per Interest, moving average
+
+  // wakeup of the sleeping consumer
+  boost::atomic<bool> m_isConsumerWaiting;
+  boost::mutex m_wakeupMutex;
+  boost::condition_variable m_wakeupCondition;
+};
+
+} // namespace ndn
+
+#endif // RECEIVE_BUFFER_HPP
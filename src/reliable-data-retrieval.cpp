@@ -22,6 +22,8 @@
 #include "reliable-data-retrieval.hpp"
 #include "consumer-context.hpp"
 
+#include <cstring>
+
 #include <ndn-cxx/security/signing-helpers.hpp>
 #include <ndn-cxx/security/verification-helpers.hpp>
 
@@ -31,11 +33,17 @@ ReliableDataRetrieval::ReliableDataRetrieval(Context* context)
   : DataRetrievalProtocol(context)
   , m_isFinalBlockNumberDiscovered(false)
   , m_finalBlockNumber(std::numeric_limits<uint64_t>::max())
-  , m_lastReassembledSegment(0)
-  , m_contentBufferSize(0)
+  , m_content(0)
+  , m_contentCapacity(0)
+  , m_contentSize(0)
+  , m_isUserContentBuffer(false)
+  , m_isDirectPlacement(false)
+  , m_segmentPayloadSize(0)
   , m_currentWindowSize(0)
   , m_interestsInFlight(0)
   , m_segNumber(0)
+  , m_congestionControl(-1)
+  , m_recoveryPoint(0)
 {
   context->getContextOption(FACE, m_face);
   m_scheduler = new Scheduler(m_face->getIoService());
@@ -55,13 +63,30 @@ ReliableDataRetrieval::start()
   m_finalBlockNumber = std::numeric_limits<uint64_t>::max();
   m_segNumber = 0;
   m_interestsInFlight = 0;
-  m_lastReassembledSegment = 0;
-  m_contentBufferSize = 0;
   m_contentBuffer.clear();
-  m_interestRetransmissions.clear();
-  m_receiveBuffer.clear();
+  m_contentSize = 0;
+  m_isDirectPlacement = false;
+  m_segmentPayloadSize = 0;
+
+  // reassemble into the buffer of the application, if it gave one
+  m_content = 0;
+  m_contentCapacity = 0;
+  dynamic_cast<Consumer*>(m_context)->getContentBuffer(m_content, m_contentCapacity);
+  m_isUserContentBuffer = (m_content != 0);
+  if (!m_isUserContentBuffer) {
+    m_contentCapacity = 0;
+  }
   m_unverifiedSegments.clear();
   m_verifiedManifests.clear();
+  m_recoveryPoint = 0;
+  m_scoreboard.reset();
+
+  // the ring grows if reassembly falls behind by more than the window
+  int maxWindowSize = -1;
+  m_context->getContextOption(MAX_WINDOW_SIZE, maxWindowSize);
+  m_segments.reset(std::max(maxWindowSize, 1));
+
+  setupCongestionControl();
 
   // this is to support window size "inheritance" between consume calls
   /*int currentWindowSize = -1;
@@ -132,9 +157,7 @@ ReliableDataRetrieval::sendInterest()
 
   Interest interest(prefix);
 
-  int interestLifetime = DEFAULT_INTEREST_LIFETIME_API;
-  m_context->getContextOption(INTEREST_LIFETIME, interestLifetime);
-  interest.setInterestLifetime(time::milliseconds(interestLifetime));
+  interest.setInterestLifetime(getInterestLifetime());
 
   SelectorHelper::applySelectors(interest, m_context);
 
@@ -149,12 +172,15 @@ ReliableDataRetrieval::sendInterest()
   //  return;
 
   m_interestsInFlight++;
-  m_interestRetransmissions[m_segNumber] = 0;
-  m_interestTimepoints[m_segNumber] = time::steady_clock::now();
-  m_expressedInterests[m_segNumber] = m_face->expressInterest(interest,
-                                                              bind(&ReliableDataRetrieval::onData, this, _1, _2),
-                                                              bind(&ReliableDataRetrieval::onNack, this, _1, _2),
-                                                              bind(&ReliableDataRetrieval::onTimeout, this, _1));
+  SegmentState* state = m_segments.find(m_segNumber);
+  state->nRetransmissions = 0;
+  state->sendTime = time::steady_clock::now();
+  state->pendingInterest = m_face->expressInterest(interest,
+                                                   bind(&ReliableDataRetrieval::onData, this, _1, _2),
+                                                   bind(&ReliableDataRetrieval::onNack, this, _1, _2),
+                                                   bind(&ReliableDataRetrieval::onTimeout, this, _1));
+  startRetxTimer(interest, m_segNumber);
+  m_scoreboard.markSent(m_segNumber, time::steady_clock::now());
   m_segNumber++;
 }
 
@@ -175,23 +201,23 @@ ReliableDataRetrieval::onData(const ndn::Interest& interest, const ndn::Data& da
   m_interestsInFlight--;
 
   uint64_t segment = interest.getName().get(-1).toSegment();
-  m_expressedInterests.erase(segment);
-  m_scheduledInterests.erase(segment);
-
-  if (m_interestTimepoints.find(segment) != m_interestTimepoints.end()) {
-    time::steady_clock::duration duration = time::steady_clock::now() - m_interestTimepoints[segment];
-    m_rttEstimator.addMeasurement(boost::chrono::duration_cast<boost::chrono::microseconds>(duration));
-
-    RttEstimator::Duration rto = m_rttEstimator.computeRto();
-    boost::chrono::milliseconds lifetime = boost::chrono::duration_cast<boost::chrono::milliseconds>(rto);
-
-    int interestLifetime = DEFAULT_INTEREST_LIFETIME_API;
-    m_context->getContextOption(INTEREST_LIFETIME, interestLifetime);
-
-    // update lifetime only if user didn't specify prefered value
-    if (interestLifetime == DEFAULT_INTEREST_LIFETIME_API) {
-      m_context->setContextOption(INTEREST_LIFETIME, (int)lifetime.count());
+  SegmentState* state = m_segments.find(segment); // nullptr if the segment is reassembled already
+
+  // Karn's rule: Data of a retransmitted Interest may answer any of its copies,
+  // so it is not an RTT sample
+  m_rttSample = time::nanoseconds::zero();
+  if (state != nullptr) {
+    state->pendingInterest = 0;
+    state->isInterestScheduled = false;
+    cancelRetxTimer(*state);
+
+    if (state->sendTime != time::steady_clock::TimePoint() && state->nRetransmissions == 0) {
+      time::steady_clock::duration duration = time::steady_clock::now() - state->sendTime;
+      m_rttEstimator.addMeasurement(boost::chrono::duration_cast<boost::chrono::microseconds>(duration));
+      m_rttSample = time::duration_cast<time::nanoseconds>(duration);
+      m_scoreboard.addRttSample(m_rttSample);
     }
+    state->sendTime = time::steady_clock::TimePoint();
   }
 
   ConsumerDataCallback onDataEnteredContext = EMPTY_CALLBACK;
@@ -218,16 +244,9 @@ ReliableDataRetrieval::onData(const ndn::Interest& interest, const ndn::Data& da
 
   if (segment == 0) // if it was the first Interest
   {
-    // in a next round try to transmit all Interests, except the first one
-    m_currentWindowSize = m_finalBlockNumber;
-
-    int maxWindowSize = -1;
-    m_context->getContextOption(MAX_WINDOW_SIZE, maxWindowSize);
-
-    // if there are too many Interests to send, put an upper boundary on it.
-    if (m_currentWindowSize > maxWindowSize) {
-      m_currentWindowSize = maxWindowSize;
-    }
+    // the controller decides how many of the remaining Interests go out in a next round
+    m_congestionController->afterFirstSegment(m_finalBlockNumber);
+    updateWindowSize();
 
     //int rtt = -1;
     //m_context->getContextOption(INTEREST_LIFETIME, rtt);
@@ -267,6 +286,41 @@ ReliableDataRetrieval::onData(const ndn::Interest& interest, const ndn::Data& da
   }
 }
 
+void
+ReliableDataRetrieval::setupCongestionControl()
+{
+  int congestionControl = DEFAULT_CONGESTION_CONTROL;
+  m_context->getContextOption(CONGESTION_CONTROL, congestionControl);
+
+  // the window is kept between consume calls unless the algorithm changes
+  if (!static_cast<bool>(m_congestionController) || congestionControl != m_congestionControl) {
+    m_congestionController = CongestionController::create(congestionControl);
+    if (!static_cast<bool>(m_congestionController)) {
+      congestionControl = DEFAULT_CONGESTION_CONTROL;
+      m_congestionController = CongestionController::create(congestionControl);
+    }
+    m_congestionControl = congestionControl;
+  }
+
+  int minWindowSize = -1;
+  m_context->getContextOption(MIN_WINDOW_SIZE, minWindowSize);
+  int maxWindowSize = -1;
+  m_context->getContextOption(MAX_WINDOW_SIZE, maxWindowSize);
+  m_congestionController->setLimits(minWindowSize, maxWindowSize);
+
+  m_currentWindowSize = m_congestionController->getWindowSize();
+}
+
+void
+ReliableDataRetrieval::updateWindowSize()
+{
+  int windowSize = m_congestionController->getWindowSize();
+  if (windowSize != m_currentWindowSize) {
+    m_currentWindowSize = windowSize;
+    m_context->setContextOption(CURRENT_WINDOW_SIZE, m_currentWindowSize);
+  }
+}
+
 void
 ReliableDataRetrieval::paceInterests(int nInterests, time::milliseconds timeWindow)
 {
@@ -277,7 +331,9 @@ ReliableDataRetrieval::paceInterests(int nInterests, time::milliseconds timeWind
 
   for (int i = 1; i <= nInterests; i++) {
     // schedule next Interest
-    m_scheduledInterests[m_segNumber + i] = m_scheduler->scheduleEvent(i * interval, bind(&ReliableDataRetrieval::sendInterest, this));
+    SegmentState* state = m_segments.find(m_segNumber + i);
+    state->scheduledInterest = m_scheduler->scheduleEvent(i * interval, bind(&ReliableDataRetrieval::sendInterest, this));
+    state->isInterestScheduled = true;
   }
 }
 
@@ -302,6 +358,24 @@ ReliableDataRetrieval::onManifestData(const ndn::Interest& interest, const ndn::
       isDataSecure = true; // TODO something more meaningful
     }
   }
+  else if (data.getSignature().hasKeyLocator() && referencesManifest(data)) {
+    // manifest is a node of a manifest tree and is secured by its parent manifest
+    uint64_t parentSegmentNumber = data.getSignature().getKeyLocator().getName().get(-1).toSegment();
+    auto parent = m_verifiedManifests.find(parentSegmentNumber);
+
+    if (parent == m_verifiedManifests.end()) {
+      // save manifest until its parent arrives
+      m_unverifiedSegments.insert(std::pair<uint64_t, shared_ptr<const Data>>(data.getName().get(-1).toSegment(), data.shared_from_this()));
+      return;
+    }
+
+    isDataSecure = verifySegmentWithManifest(*(parent->second), data);
+
+    if (!isDataSecure) {
+      retransmitInterestWithDigest(interest, data, *(parent->second));
+      return;
+    }
+  }
   else {
     // run verification routine
     if (onDataToVerify(*dynamic_cast<Consumer*>(m_context), data)) {
@@ -312,47 +386,85 @@ ReliableDataRetrieval::onManifestData(const ndn::Interest& interest, const ndn::
   if (isDataSecure) {
     checkFastRetransmissionConditions(interest);
 
-    int maxWindowSize = -1;
-    m_context->getContextOption(MAX_WINDOW_SIZE, maxWindowSize);
-    if (m_currentWindowSize < maxWindowSize) { // don't expand window above max level
-      m_currentWindowSize++;
-      m_context->setContextOption(CURRENT_WINDOW_SIZE, m_currentWindowSize);
-    }
+    m_congestionController->afterData(m_rttSample);
+    updateWindowSize();
 
-    shared_ptr<Manifest> manifest = make_shared<Manifest>(data);
+    acceptManifest(make_shared<Manifest>(data));
+  }
+  else {
+    // failed to verify manifest
+    retransmitInterestWithExclude(interest, data);
+  }
+}
 
-    //std::cout << "MANIFEST CONTAINS " << manifest->size() << " names" << std::endl;
+void
+ReliableDataRetrieval::acceptManifest(shared_ptr<const Manifest> manifest)
+{
+  //std::cout << "MANIFEST CONTAINS " << manifest->size() << " names" << std::endl;
+  uint64_t segment = manifest->getName().get(-1).toSegment();
 
-    m_verifiedManifests.insert(std::pair<uint64_t, shared_ptr<Manifest>>(data.getName().get(-1).toSegment(), manifest));
+  m_verifiedManifests[segment] = manifest;
+  bufferSegment(manifest);
 
-    m_receiveBuffer[manifest->getName().get(-1).toSegment()] = manifest;
+  if (!manifest->getFinalBlockId().empty()) {
+    m_isFinalBlockNumberDiscovered = true;
+    m_finalBlockNumber = manifest->getFinalBlockId().toSegment();
+  }
 
-    // TODO: names in manifest are in order, so we can exit the loop earlier
-    for (auto it = m_unverifiedSegments.begin(); it != m_unverifiedSegments.end(); ++it) {
-      if (!m_isRunning) {
-        return;
-      }
+  verifyPendingSegments(*manifest);
+  reassemble();
+}
 
-      // data segment is verified with manifest
-      if (verifySegmentWithManifest(*manifest, *(it->second))) {
-        if (!it->second->getFinalBlockId().empty()) {
-          m_isFinalBlockNumberDiscovered = true;
-          m_finalBlockNumber = it->second->getFinalBlockId().toSegment();
-        }
+void
+ReliableDataRetrieval::verifyPendingSegments(const Manifest& manifest)
+{
+  // take out the segments that point to this manifest
+  std::vector<shared_ptr<const Data>> pendingSegments;
+  for (auto it = m_unverifiedSegments.begin(); it != m_unverifiedSegments.end();) {
+    const Signature& signature = it->second->getSignature();
+    if (signature.hasKeyLocator() && signature.getKeyLocator().getName() == manifest.getName()) {
+      pendingSegments.push_back(it->second);
+      it = m_unverifiedSegments.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+  // hash all segments waiting for this manifest at once
+  Sha256Batch batch;
+  for (const shared_ptr<const Data>& segment : pendingSegments) {
+    batch.add(segment->wireEncode());
+  }
+  std::vector<ConstBufferPtr> implicitDigests = batch.compute();
+
+  for (size_t i = 0; i < pendingSegments.size(); i++) {
+    if (!m_isRunning) {
+      return;
+    }
 
-        m_receiveBuffer[it->second->getName().get(-1).toSegment()] = it->second;
-        reassemble();
+    const shared_ptr<const Data>& segment = pendingSegments[i];
+
+    // data segment is verified with manifest
+    if (verifySegmentWithManifest(manifest, *segment, implicitDigests[i])) {
+      if (segment->getContentType() == MANIFEST_DATA_TYPE) {
+        // child manifest of a manifest tree, which may in turn secure other pending segments
+        acceptManifest(make_shared<Manifest>(*segment));
+        continue;
       }
-      else {
-        // data segment failed verification with manifest
-        // retransmit interest with implicit digest from the manifest
-        retransmitInterestWithDigest(interest, data, *manifest);
+
+      if (!segment->getFinalBlockId().empty()) {
+        m_isFinalBlockNumberDiscovered = true;
+        m_finalBlockNumber = segment->getFinalBlockId().toSegment();
       }
+
+      bufferSegment(segment);
+    }
+    else {
+      // data segment failed verification with manifest
+      // retransmit interest with implicit digest from the manifest
+      retransmitInterestWithDigest(Interest(segment->getName()), *segment, manifest);
     }
-  }
-  else {
-    // failed to verify manifest
-    retransmitInterestWithExclude(interest, data);
   }
 }
 
@@ -363,12 +475,16 @@ ReliableDataRetrieval::retransmitFreshInterest(const ndn::Interest& interest)
   m_context->getContextOption(INTEREST_RETX, maxRetransmissions);
 
   uint64_t segment = interest.getName().get(-1).toSegment();
-  if (m_interestRetransmissions[segment] < maxRetransmissions) {
+  SegmentState* state = m_segments.find(segment);
+  if (state == nullptr)
+    return; // the segment arrived in the meantime
+
+  state->isInterestScheduled = false;
+
+  if (state->nRetransmissions < maxRetransmissions) {
     if (m_isRunning) {
       Interest retxInterest(interest.getName()); // because we need new nonce
-      int interestLifetime = DEFAULT_INTEREST_LIFETIME_API;
-      m_context->getContextOption(INTEREST_LIFETIME, interestLifetime);
-      retxInterest.setInterestLifetime(time::milliseconds(interestLifetime));
+      retxInterest.setInterestLifetime(getInterestLifetime());
 
       SelectorHelper::applySelectors(retxInterest, m_context);
 
@@ -394,12 +510,7 @@ ReliableDataRetrieval::retransmitFreshInterest(const ndn::Interest& interest)
       if (m_isRunning == false)
         return;
 
-      m_interestsInFlight++;
-      m_interestRetransmissions[segment]++;
-      m_expressedInterests[segment] = m_face->expressInterest(retxInterest,
-                                                              bind(&ReliableDataRetrieval::onData, this, _1, _2),
-                                                              bind(&ReliableDataRetrieval::onNack, this, _1, _2),
-                                                              bind(&ReliableDataRetrieval::onTimeout, this, _1));
+      expressRetransmission(retxInterest, segment);
     }
   }
   else {
@@ -416,11 +527,13 @@ ReliableDataRetrieval::retransmitInterestWithExclude(const ndn::Interest& intere
   uint64_t segment = interest.getName().get(-1).toSegment();
   m_unverifiedSegments.erase(segment); // remove segment, because it is useless
 
-  if (m_interestRetransmissions[segment] < maxRetransmissions) {
+  SegmentState* state = m_segments.find(segment);
+  if (state == nullptr)
+    return false; // the segment was reassembled from another copy
+
+  if (state->nRetransmissions < maxRetransmissions) {
     Interest interestWithExlusion(interest.getName());
-    int interestLifetime = DEFAULT_INTEREST_LIFETIME_API;
-    m_context->getContextOption(INTEREST_LIFETIME, interestLifetime);
-    interestWithExlusion.setInterestLifetime(time::milliseconds(interestLifetime));
+    interestWithExlusion.setInterestLifetime(getInterestLifetime());
 
     SelectorHelper::applySelectors(interestWithExlusion, m_context);
 
@@ -455,12 +568,7 @@ ReliableDataRetrieval::retransmitInterestWithExclude(const ndn::Interest& intere
       return false;
 
     //retransmit
-    m_interestsInFlight++;
-    m_interestRetransmissions[segment]++;
-    m_expressedInterests[segment] = m_face->expressInterest(interestWithExlusion,
-                                                            bind(&ReliableDataRetrieval::onData, this, _1, _2),
-                                                            bind(&ReliableDataRetrieval::onNack, this, _1, _2),
-                                                            bind(&ReliableDataRetrieval::onTimeout, this, _1));
+    expressRetransmission(interestWithExlusion, segment);
   }
   else {
     m_isRunning = false;
@@ -479,7 +587,11 @@ ReliableDataRetrieval::retransmitInterestWithDigest(const ndn::Interest& interes
   uint64_t segment = interest.getName().get(-1).toSegment();
   m_unverifiedSegments.erase(segment); // remove segment, because it is useless
 
-  if (m_interestRetransmissions[segment] < maxRetransmissions) {
+  SegmentState* state = m_segments.find(segment);
+  if (state == nullptr)
+    return false; // the segment was reassembled from another copy
+
+  if (state->nRetransmissions < maxRetransmissions) {
     name::Component implicitDigest = getDigestFromManifest(manifestSegment, dataSegment);
     if (implicitDigest.empty()) {
       m_isRunning = false;
@@ -490,9 +602,7 @@ ReliableDataRetrieval::retransmitInterestWithDigest(const ndn::Interest& interes
     nameWithDigest.append(implicitDigest);
 
     Interest interestWithDigest(nameWithDigest);
-    int interestLifetime = DEFAULT_INTEREST_LIFETIME_API;
-    m_context->getContextOption(INTEREST_LIFETIME, interestLifetime);
-    interestWithDigest.setInterestLifetime(time::milliseconds(interestLifetime));
+    interestWithDigest.setInterestLifetime(getInterestLifetime());
 
     SelectorHelper::applySelectors(interestWithDigest, m_context);
 
@@ -514,12 +624,7 @@ ReliableDataRetrieval::retransmitInterestWithDigest(const ndn::Interest& interes
       return false;
 
     //retransmit
-    m_interestsInFlight++;
-    m_interestRetransmissions[segment]++;
-    m_expressedInterests[segment] = m_face->expressInterest(interestWithDigest,
-                                                            bind(&ReliableDataRetrieval::onData, this, _1, _2),
-                                                            bind(&ReliableDataRetrieval::onNack, this, _1, _2),
-                                                            bind(&ReliableDataRetrieval::onTimeout, this, _1));
+    expressRetransmission(interestWithDigest, segment);
   }
   else {
     m_isRunning = false;
@@ -565,16 +670,7 @@ ReliableDataRetrieval::onNackData(const ndn::Interest& interest, const ndn::Data
   if (isDataSecure) {
     checkFastRetransmissionConditions(interest);
 
-    int minWindowSize = -1;
-    m_context->getContextOption(MIN_WINDOW_SIZE, minWindowSize);
-    if (m_currentWindowSize > minWindowSize) // don't shrink window below minimum level
-    {
-      m_currentWindowSize = m_currentWindowSize / 2; // cut in half
-      if (m_currentWindowSize == 0)
-        m_currentWindowSize++;
-
-      m_context->setContextOption(CURRENT_WINDOW_SIZE, m_currentWindowSize);
-    }
+    decreaseWindow(interest.getName().get(-1).toSegment(), false);
 
     shared_ptr<ApplicationNack> nack = make_shared<ApplicationNack>(data);
 
@@ -596,10 +692,12 @@ ReliableDataRetrieval::onNackData(const ndn::Interest& interest, const ndn::Data
       }
 
       case ApplicationNack::PRODUCER_DELAY: {
-        uint64_t segment = interest.getName().get(-1).toSegment();
-
-        m_scheduledInterests[segment] = m_scheduler->scheduleEvent(time::milliseconds(nack->getDelay()),
-                                                                   bind(&ReliableDataRetrieval::retransmitFreshInterest, this, interest));
+        SegmentState* state = m_segments.find(interest.getName().get(-1).toSegment());
+        if (state != nullptr) {
+          state->scheduledInterest = m_scheduler->scheduleEvent(time::milliseconds(nack->getDelay()),
+                                                                bind(&ReliableDataRetrieval::retransmitFreshInterest, this, interest));
+          state->isInterestScheduled = true;
+        }
 
         break;
       }
@@ -675,20 +773,15 @@ ReliableDataRetrieval::onContentData(const ndn::Interest& interest, const ndn::D
   if (isDataSecure) {
     checkFastRetransmissionConditions(interest);
 
-    int maxWindowSize = -1;
-    m_context->getContextOption(MAX_WINDOW_SIZE, maxWindowSize);
-    if (m_currentWindowSize < maxWindowSize) // don't expand window above max level
-    {
-      m_currentWindowSize++;
-      m_context->setContextOption(CURRENT_WINDOW_SIZE, m_currentWindowSize);
-    }
+    m_congestionController->afterData(m_rttSample);
+    updateWindowSize();
 
     if (!data.getFinalBlockId().empty()) {
       m_isFinalBlockNumberDiscovered = true;
       m_finalBlockNumber = data.getFinalBlockId().toSegment();
     }
 
-    m_receiveBuffer[data.getName().get(-1).toSegment()] = data.shared_from_this();
+    bufferSegment(data.shared_from_this());
     reassemble();
   }
 }
@@ -727,34 +820,32 @@ ReliableDataRetrieval::onTimeout(const ndn::Interest& interest)
   }
 
   uint64_t segment = interest.getName().get(-1).toSegment();
-  m_expressedInterests.erase(segment);
-  m_scheduledInterests.erase(segment);
+  SegmentState* state = m_segments.find(segment);
+  if (state == nullptr)
+    return; // the segment was reassembled from another copy
+
+  state->pendingInterest = 0;
+  state->isInterestScheduled = false;
+  cancelRetxTimer(*state);
 
   if (m_isFinalBlockNumberDiscovered) {
     if (interest.getName().get(-1).toSegment() > m_finalBlockNumber)
       return;
   }
 
-  int minWindowSize = -1;
-  m_context->getContextOption(MIN_WINDOW_SIZE, minWindowSize);
-  if (m_currentWindowSize > minWindowSize) // don't shrink window below minimum level
-  {
-    m_currentWindowSize = m_currentWindowSize / 2; // cut in half
-
-    if (m_currentWindowSize == 0)
-      m_currentWindowSize++;
-
-    m_context->setContextOption(CURRENT_WINDOW_SIZE, m_currentWindowSize);
+  // a retransmission that timed out again belongs to a loss event that already cut the
+  // window, but the RTO keeps backing off while the path stalls
+  if (state->nRetransmissions > 0 && segment < m_recoveryPoint) {
+    m_rttEstimator.doubleMultiplier();
   }
+  decreaseWindow(segment, true);
 
   int maxRetransmissions;
   m_context->getContextOption(INTEREST_RETX, maxRetransmissions);
 
-  if (m_interestRetransmissions[segment] < maxRetransmissions) {
+  if (state->nRetransmissions < maxRetransmissions) {
     Interest retxInterest(interest.getName()); // because we need new nonce
-    int interestLifetime = DEFAULT_INTEREST_LIFETIME_API;
-    m_context->getContextOption(INTEREST_LIFETIME, interestLifetime);
-    retxInterest.setInterestLifetime(time::milliseconds(interestLifetime));
+    retxInterest.setInterestLifetime(getInterestLifetime());
 
     SelectorHelper::applySelectors(retxInterest, m_context);
 
@@ -779,12 +870,7 @@ ReliableDataRetrieval::onTimeout(const ndn::Interest& interest)
       return;
 
     //retransmit
-    m_interestsInFlight++;
-    m_interestRetransmissions[segment]++;
-    m_expressedInterests[segment] = m_face->expressInterest(retxInterest,
-                                                            bind(&ReliableDataRetrieval::onData, this, _1, _2),
-                                                            bind(&ReliableDataRetrieval::onNack, this, _1, _2),
-                                                            bind(&ReliableDataRetrieval::onTimeout, this, _1));
+    expressRetransmission(retxInterest, segment);
   }
   else {
     m_isRunning = false;
@@ -792,47 +878,283 @@ ReliableDataRetrieval::onTimeout(const ndn::Interest& interest)
   }
 }
 
+void
+ReliableDataRetrieval::onRetxTimeout(const Interest& interest)
+{
+  SegmentState* state = m_segments.find(interest.getName().get(-1).toSegment());
+  if (state == nullptr)
+    return;
+
+  state->isRetxTimerSet = false;
+
+  // the Interest stays in the PIT until its lifetime expires, so it is withdrawn
+  // before the retransmission in onTimeout
+  if (state->pendingInterest != 0) {
+    m_face->removePendingInterest(state->pendingInterest);
+  }
+
+  onTimeout(interest);
+}
+
+void
+ReliableDataRetrieval::startRetxTimer(const Interest& interest, uint64_t segment)
+{
+  SegmentState* state = m_segments.find(segment);
+  cancelRetxTimer(*state);
+
+  RttEstimator::Duration rto = m_rttEstimator.computeRto();
+  state->retxTimer = m_scheduler->scheduleEvent(time::duration_cast<time::nanoseconds>(rto),
+                                                bind(&ReliableDataRetrieval::onRetxTimeout, this, interest));
+  state->isRetxTimerSet = true;
+}
+
+void
+ReliableDataRetrieval::cancelRetxTimer(SegmentState& state)
+{
+  if (state.isRetxTimerSet) {
+    m_scheduler->cancelEvent(state.retxTimer);
+    state.isRetxTimerSet = false;
+  }
+}
+
+void
+ReliableDataRetrieval::expressRetransmission(const Interest& interest, uint64_t segment)
+{
+  SegmentState* state = m_segments.find(segment);
+
+  // a fast retransmission replaces an Interest that is still in the PIT
+  if (state->pendingInterest != 0) {
+    m_face->removePendingInterest(state->pendingInterest);
+    state->pendingInterest = 0;
+    m_interestsInFlight--;
+  }
+
+  m_interestsInFlight++;
+  state->nRetransmissions++;
+  state->pendingInterest = m_face->expressInterest(interest,
+                                                   bind(&ReliableDataRetrieval::onData, this, _1, _2),
+                                                   bind(&ReliableDataRetrieval::onNack, this, _1, _2),
+                                                   bind(&ReliableDataRetrieval::onTimeout, this, _1));
+  startRetxTimer(interest, segment);
+  m_scoreboard.markSent(segment, time::steady_clock::now());
+}
+
+void
+ReliableDataRetrieval::bufferSegment(const shared_ptr<const Data>& data)
+{
+  uint64_t segment = data->getName().get(-1).toSegment();
+  SegmentState* state = m_segments.find(segment);
+  if (state == nullptr)
+    return;
+
+  bool isContent = (data->getContentType() == CONTENT_DATA_TYPE);
+
+  // without manifests the first segment is content, and all segments but the last one
+  // carry the same amount of payload, so each segment has a known offset in the ADU
+  if (segment == 0 && isContent && m_isFinalBlockNumberDiscovered) {
+    startDirectPlacement(data->getContent().value_size());
+  }
+
+  if (m_isDirectPlacement && isContent && placeContent(*data)) {
+    state->isPlaced = true; // the Data is released as soon as the caller returns
+  }
+  else {
+    state->data = data;
+  }
+}
+
+void
+ReliableDataRetrieval::decreaseWindow(uint64_t segment, bool isTimeout)
+{
+  // losses of segments that were sent before the last reduction belong to the same
+  // loss event (one round trip), which shrinks the window and backs off the RTO only once
+  if (segment < m_recoveryPoint)
+    return;
+
+  m_recoveryPoint = m_segNumber;
+  if (isTimeout) {
+    m_rttEstimator.doubleMultiplier(); // exponential backoff until the next RTT sample
+  }
+  m_congestionController->afterLoss();
+  updateWindowSize();
+}
+
+time::milliseconds
+ReliableDataRetrieval::getInterestLifetime()
+{
+  int interestLifetime = DEFAULT_INTEREST_LIFETIME_API;
+  m_context->getContextOption(INTEREST_LIFETIME, interestLifetime);
+
+  // unless the application asked for a lifetime, retransmissions are driven by the RTO timers
+  if (interestLifetime == DEFAULT_INTEREST_LIFETIME_API)
+    return time::milliseconds(DEFAULT_RDR_INTEREST_LIFETIME);
+
+  return time::milliseconds(interestLifetime);
+}
+
+void
+ReliableDataRetrieval::startDirectPlacement(size_t segmentPayloadSize)
+{
+  if (segmentPayloadSize == 0 || m_finalBlockNumber >= std::numeric_limits<size_t>::max() / segmentPayloadSize)
+    return;
+
+  m_isDirectPlacement = true;
+  m_segmentPayloadSize = segmentPayloadSize;
+
+  // the ADU is at most this large, its exact size is known with the last segment
+  if (!m_isUserContentBuffer) {
+    reserveContent((m_finalBlockNumber + 1) * m_segmentPayloadSize);
+  }
+}
+
+void
+ReliableDataRetrieval::stopDirectPlacement(const Name& prefix)
+{
+  // the end of the last segment, if it is placed already
+  size_t placedContentEnd = m_contentSize;
+
+  // the segments below the base are in order, each of them is exactly one payload size long
+  m_contentSize = m_segments.getBase() * m_segmentPayloadSize;
+
+  // the segments placed ahead of the base are copied out of the buffer,
+  // so that they are appended in order like the others
+  for (uint64_t segment = m_segments.getBase(); segment < m_segments.getEnd(); segment++) {
+    SegmentState* state = m_segments.find(segment);
+    if (!state->isPlaced)
+      continue;
+
+    size_t offset = segment * m_segmentPayloadSize;
+    size_t size = (segment == m_finalBlockNumber) ? placedContentEnd - offset : m_segmentPayloadSize;
+
+    shared_ptr<Data> data = make_shared<Data>(Name(prefix).appendSegment(segment));
+    data->setContent(m_content + offset, size);
+
+    state->data = data;
+    state->isPlaced = false;
+  }
+
+  m_isDirectPlacement = false;
+}
+
+bool
+ReliableDataRetrieval::placeContent(const Data& data)
+{
+  uint64_t segment = data.getName().get(-1).toSegment();
+  const Block& content = data.getContent();
+
+  bool isSizeExpected = (segment < m_finalBlockNumber) ? content.value_size() == m_segmentPayloadSize
+                                                        : content.value_size() <= m_segmentPayloadSize;
+  if (segment > m_finalBlockNumber || !isSizeExpected) {
+    // offsets computed from the first segment would be wrong
+    stopDirectPlacement(data.getName().getPrefix(-1));
+    return false;
+  }
+
+  size_t offset = segment * m_segmentPayloadSize;
+  writeContent(offset, content.value(), content.value_size());
+  m_contentSize = std::max(m_contentSize, offset + content.value_size());
+  return true;
+}
+
 void
 ReliableDataRetrieval::copyContent(const Data& data)
 {
-  const Block content = data.getContent();
-  m_contentBuffer.insert(m_contentBuffer.end(), &content.value()[0], &content.value()[content.value_size()]);
+  if (m_isDirectPlacement && placeContent(data)) {
+    return;
+  }
 
-  if ((data.getName().at(-1).toSegment() == m_finalBlockNumber) || (!m_isRunning)) {
-    removeAllPendingInterests();
-    removeAllScheduledInterests();
+  const Block& content = data.getContent();
+  writeContent(m_contentSize, content.value(), content.value_size());
+  m_contentSize += content.value_size();
+}
 
-    // return content to the user
-    ConsumerContentCallback onPayload = EMPTY_CALLBACK;
-    m_context->getContextOption(CONTENT_RETRIEVED, onPayload);
-    if (onPayload != EMPTY_CALLBACK) {
-      onPayload(*dynamic_cast<Consumer*>(m_context), m_contentBuffer.data(), m_contentBuffer.size());
-    }
+void
+ReliableDataRetrieval::writeContent(size_t offset, const uint8_t* bytes, size_t size)
+{
+  if (offset + size > m_contentCapacity) {
+    if (m_isDirectPlacement)
+      reserveContent(std::max(offset + size, (m_finalBlockNumber + 1) * m_segmentPayloadSize));
+    else
+      reserveContent(std::max(offset + size, 2 * m_contentCapacity));
+  }
 
-    //reduce window size to prevent its speculative growth in case when consume() is called in loop
-    int currentWindowSize = -1;
-    m_context->getContextOption(CURRENT_WINDOW_SIZE, currentWindowSize);
-    if (currentWindowSize > m_finalBlockNumber) {
-      m_context->setContextOption(CURRENT_WINDOW_SIZE, (int)(m_finalBlockNumber));
-    }
+  std::memcpy(m_content + offset, bytes, size);
+}
 
-    m_isRunning = false;
+void
+ReliableDataRetrieval::reserveContent(size_t capacity)
+{
+  if (capacity <= m_contentCapacity)
+    return;
+
+  if (m_isUserContentBuffer) {
+    // the ADU does not fit into the buffer of the application
+    m_contentBuffer.resize(capacity);
+    std::memcpy(m_contentBuffer.data(), m_content, m_contentCapacity);
+    m_isUserContentBuffer = false;
+  }
+  else {
+    m_contentBuffer.resize(capacity);
   }
+
+  m_content = m_contentBuffer.data();
+  m_contentCapacity = capacity;
+}
+
+void
+ReliableDataRetrieval::returnContent()
+{
+  removeAllPendingInterests();
+  removeAllScheduledInterests();
+
+  // only the contiguous part from the beginning of the ADU, when the transfer ended early
+  size_t contentSize = m_contentSize;
+  if (m_isDirectPlacement) {
+    contentSize = std::min<uint64_t>(contentSize, m_segments.getBase() * m_segmentPayloadSize);
+  }
+
+  // return content to the user
+  ConsumerContentCallback onPayload = EMPTY_CALLBACK;
+  m_context->getContextOption(CONTENT_RETRIEVED, onPayload);
+  if (onPayload != EMPTY_CALLBACK) {
+    onPayload(*dynamic_cast<Consumer*>(m_context), m_content, contentSize);
+  }
+
+  //reduce window size to prevent its speculative growth in case when consume() is called in loop
+  int currentWindowSize = -1;
+  m_context->getContextOption(CURRENT_WINDOW_SIZE, currentWindowSize);
+  if (currentWindowSize > m_finalBlockNumber) {
+    m_context->setContextOption(CURRENT_WINDOW_SIZE, (int)(m_finalBlockNumber));
+  }
+
+  m_isRunning = false;
 }
 
 void
 ReliableDataRetrieval::reassemble()
 {
-  auto head = m_receiveBuffer.find(m_lastReassembledSegment);
-  while (head != m_receiveBuffer.end()) {
+  while (m_segments.getBase() < m_segments.getEnd()) {
+    uint64_t segment = m_segments.getBase();
+    SegmentState* head = m_segments.find(segment);
+    if (!head->isPlaced && !static_cast<bool>(head->data))
+      break;
+
     // do not copy from manifests
-    if (head->second->getContentType() == CONTENT_DATA_TYPE) {
-      copyContent(*(head->second));
+    if (static_cast<bool>(head->data) && head->data->getContentType() == CONTENT_DATA_TYPE) {
+      copyContent(*(head->data));
+    }
+
+    if (head->isInterestScheduled) {
+      m_scheduler->cancelEvent(head->scheduledInterest);
     }
+    cancelRetxTimer(*head);
+
+    m_segments.pop();
 
-    m_receiveBuffer.erase(head);
-    m_lastReassembledSegment++;
-    head = m_receiveBuffer.find(m_lastReassembledSegment);
+    if (segment == m_finalBlockNumber || !m_isRunning) {
+      returnContent();
+      break;
+    }
   }
 }
 
@@ -842,17 +1164,11 @@ ReliableDataRetrieval::verifySegmentWithManifest(const Manifest& manifestSegment
   //std::cout << "Verify Segment With MAnifest" << std::endl;
   bool result = false;
 
-  for (std::list<Name>::const_iterator it = manifestSegment.catalogueBegin(); it != manifestSegment.catalogueEnd(); ++it) {
-    if (it->get(-2) == dataSegment.getName().get(-1)) // if segment numbers match
-    {
-      if (dataSegment.getFullName().get(-1) == it->get(-1)) {
-        result = true;
-        break;
-      }
-      else {
-        break;
-      }
-    }
+  name::Component expectedDigest = getDigestFromManifest(manifestSegment, dataSegment);
+  if (!expectedDigest.empty()) {
+    // getFullName() hashes the packet once and caches the result inside the Data,
+    // so a later retransmission with Exclude does not hash it again
+    result = (dataSegment.getFullName().get(-1) == expectedDigest);
   }
 
   //if (!result)
@@ -861,6 +1177,18 @@ ReliableDataRetrieval::verifySegmentWithManifest(const Manifest& manifestSegment
   return result;
 }
 
+bool
+ReliableDataRetrieval::verifySegmentWithManifest(const Manifest& manifestSegment, const Data& dataSegment,
+                                                 const ConstBufferPtr& implicitDigest)
+{
+  name::Component expectedDigest = getDigestFromManifest(manifestSegment, dataSegment);
+  if (expectedDigest.empty()) {
+    return false;
+  }
+
+  return expectedDigest == name::Component::fromImplicitSha256Digest(implicitDigest);
+}
+
 name::Component
 ReliableDataRetrieval::getDigestFromManifest(const Manifest& manifestSegment, const Data& dataSegment)
 {
@@ -881,30 +1209,13 @@ void
 ReliableDataRetrieval::checkFastRetransmissionConditions(const ndn::Interest& interest)
 {
   uint64_t segNumber = interest.getName().get(-1).toSegment();
-  m_receivedSegments[segNumber] = true;
-  m_fastRetxSegments.erase(segNumber);
+  if (!m_scoreboard.markReceived(segNumber))
+    return; // a duplicate does not tell anything new
 
-  uint64_t possiblyLostSegment = 0;
-  uint64_t highestReceivedSegment = m_receivedSegments.rbegin()->first;
-
-  for (uint64_t i = 0; i <= highestReceivedSegment; i++) {
-    if (m_receivedSegments.find(i) == m_receivedSegments.end()) // segment is not received yet
-    {
-      // segment has not been fast retransmitted yet
-      if (m_fastRetxSegments.find(i) == m_fastRetxSegments.end()) {
-        possiblyLostSegment = i;
-        uint8_t nOutOfOrderSegments = 0;
-        for (uint64_t j = i; j <= highestReceivedSegment; j++) {
-          if (m_receivedSegments.find(j) != m_receivedSegments.end()) {
-            nOutOfOrderSegments++;
-            if (nOutOfOrderSegments == DEFAULT_FAST_RETX_CONDITION) {
-              m_fastRetxSegments[possiblyLostSegment] = true;
-              fastRetransmit(interest, possiblyLostSegment);
-            }
-          }
-        }
-      }
-    }
+  std::vector<uint64_t> lostSegments;
+  m_scoreboard.detectLosses(lostSegments);
+  for (uint64_t lostSegment : lostSegments) {
+    fastRetransmit(interest, lostSegment);
   }
 }
 
@@ -914,7 +1225,8 @@ ReliableDataRetrieval::fastRetransmit(const ndn::Interest& interest, uint64_t se
   int maxRetransmissions;
   m_context->getContextOption(INTEREST_RETX, maxRetransmissions);
 
-  if (m_interestRetransmissions[segNumber] < maxRetransmissions) {
+  SegmentState* state = m_segments.find(segNumber);
+  if (state != nullptr && state->nRetransmissions < maxRetransmissions) {
     Name name = interest.getName().getPrefix(-1);
     name.appendSegment(segNumber);
 
@@ -942,13 +1254,7 @@ ReliableDataRetrieval::fastRetransmit(const ndn::Interest& interest, uint64_t se
       return;
 
     //retransmit
-    m_interestsInFlight++;
-    m_interestRetransmissions[segNumber]++;
-    //std::cout << "fast retx" << std::endl;
-    m_expressedInterests[segNumber] = m_face->expressInterest(retxInterest,
-                                                              bind(&ReliableDataRetrieval::onData, this, _1, _2),
-                                                              bind(&ReliableDataRetrieval::onNack, this, _1, _2),
-                                                              bind(&ReliableDataRetrieval::onTimeout, this, _1));
+    expressRetransmission(retxInterest, segNumber);
   }
 }
 
@@ -964,23 +1270,31 @@ ReliableDataRetrieval::removeAllPendingInterests()
   }
   else // slower, but destroys only necessary Interests
   {
-    for (std::unordered_map<uint64_t, const PendingInterestId*>::iterator it = m_expressedInterests.begin(); it != m_expressedInterests.end();
-         ++it) {
-      m_face->removePendingInterest(it->second);
+    for (uint64_t segment = m_segments.getBase(); segment < m_segments.getEnd(); segment++) {
+      SegmentState* state = m_segments.find(segment);
+      if (state->pendingInterest != 0) {
+        m_face->removePendingInterest(state->pendingInterest);
+      }
     }
   }
 
-  m_expressedInterests.clear();
+  for (uint64_t segment = m_segments.getBase(); segment < m_segments.getEnd(); segment++) {
+    SegmentState* state = m_segments.find(segment);
+    state->pendingInterest = 0;
+    cancelRetxTimer(*state);
+  }
 }
 
 void
 ReliableDataRetrieval::removeAllScheduledInterests()
 {
-  for (std::unordered_map<uint64_t, EventId>::iterator it = m_scheduledInterests.begin(); it != m_scheduledInterests.end(); ++it) {
-    m_scheduler->cancelEvent(it->second);
+  for (uint64_t segment = m_segments.getBase(); segment < m_segments.getEnd(); segment++) {
+    SegmentState* state = m_segments.find(segment);
+    if (state->isInterestScheduled) {
+      m_scheduler->cancelEvent(state->scheduledInterest);
+      state->isInterestScheduled = false;
+    }
   }
-
-  m_scheduledInterests.clear();
 }
 
 } //namespace ndn
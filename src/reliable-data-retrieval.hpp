@@ -22,9 +22,13 @@
 #ifndef RELIABLE_DATA_RETRIEVAL_HPP
 #define RELIABLE_DATA_RETRIEVAL_HPP
 
+#include "congestion-controller.hpp"
 #include "data-retrieval-protocol.hpp"
 #include "rtt-estimator.hpp"
+#include "segment-ring.hpp"
+#include "segment-scoreboard.hpp"
 #include "selector-helper.hpp"
+#include "sha256-batch.hpp"
 
 namespace ndn {
 
@@ -81,9 +85,47 @@ private:
   void
   onTimeout(const Interest& interest);
 
+  /** \brief retransmits the Interest when its RTO timer fires before the Data arrives
+   */
+  void
+  onRetxTimeout(const Interest& interest);
+
+  /** \brief (re)starts the RTO timer of the segment with RttEstimator::computeRto()
+   */
+  void
+  startRetxTimer(const Interest& interest, uint64_t segment);
+
+  void
+  cancelRetxTimer(SegmentState& state);
+
+  /** \brief expresses a retransmitted Interest for the segment and restarts its RTO timer
+   */
+  void
+  expressRetransmission(const Interest& interest, uint64_t segment);
+
+  /** \brief keeps the verified segment (or manifest) until it can be reassembled
+   */
+  void
+  bufferSegment(const shared_ptr<const Data>& data);
+
+  /** \brief reacts to the loss of the segment, at most once per loss event
+   *  \param isTimeout whether the loss was detected by the RTO timer, which then backs off
+   */
+  void
+  decreaseWindow(uint64_t segment, bool isTimeout);
+
+  time::milliseconds
+  getInterestLifetime();
+
   void
   onManifestData(const Interest& interest, const Data& data);
 
+  void
+  acceptManifest(shared_ptr<const Manifest> manifest);
+
+  void
+  verifyPendingSegments(const Manifest& manifest);
+
   void
   onNackData(const Interest& interest, const Data& data);
 
@@ -93,9 +135,44 @@ private:
   void
   reassemble();
 
+  /** \brief appends the payload of the next in-order segment to the ADU
+   */
   void
   copyContent(const Data& data);
 
+  /** \brief enables writing of segments straight to their offset in the ADU
+   *  Used when the segments are not interleaved with manifests, so that the offset
+   *  of each segment follows from the payload size of the first one.
+   */
+  void
+  startDirectPlacement(size_t segmentPayloadSize);
+
+  /** \brief leaves direct placement for in-order copying, keeping the segments placed so far
+   *  \param prefix name of the ADU, without the segment number
+   */
+  void
+  stopDirectPlacement(const Name& prefix);
+
+  /** \brief writes the payload of a segment to its offset in the ADU
+   *  \return{ false if the payload size does not fit the offsets, direct placement is stopped then }
+   */
+  bool
+  placeContent(const Data& data);
+
+  void
+  writeContent(size_t offset, const uint8_t* bytes, size_t size);
+
+  /** \brief makes the reassembly buffer hold at least capacity bytes
+   *  Moves the ADU to the internal buffer if it outgrows the buffer of the application.
+   */
+  void
+  reserveContent(size_t capacity);
+
+  /** \brief passes the reassembled ADU to CONTENT_RETRIEVED and ends the transfer
+   */
+  void
+  returnContent();
+
   bool
   referencesManifest(const Data& data);
 
@@ -111,9 +188,18 @@ private:
   bool
   verifySegmentWithManifest(const Manifest& manifestSegment, const Data& dataSegment);
 
+  /** \brief verifies the segment with an implicit digest that was computed beforehand
+   */
+  bool
+  verifySegmentWithManifest(const Manifest& manifestSegment, const Data& dataSegment,
+                            const ConstBufferPtr& implicitDigest);
+
   name::Component
   getDigestFromManifest(const Manifest& manifestSegment, const Data& dataSegment);
 
+  /** \brief marks the segment of the Interest as received and fast retransmits the segments
+   *  that are detected as lost
+   */
   void
   checkFastRetransmissionConditions(const Interest& interest);
 
@@ -129,6 +215,17 @@ private:
   void
   paceInterests(int nInterests, time::milliseconds timeWindow);
 
+  /** \brief creates the controller selected by CONGESTION_CONTROL (if it changed)
+   *  and passes it the window limits
+   */
+  void
+  setupCongestionControl();
+
+  /** \brief takes the window from the congestion controller
+   */
+  void
+  updateWindowSize();
+
 private:
   Scheduler* m_scheduler;
   KeyChain m_keyChain;
@@ -136,28 +233,31 @@ private:
   // reassembly variables
   bool m_isFinalBlockNumberDiscovered;
   uint64_t m_finalBlockNumber;
-  uint64_t m_lastReassembledSegment;
-  std::vector<uint8_t> m_contentBuffer;
-  size_t m_contentBufferSize;
+  std::vector<uint8_t> m_contentBuffer; // unless the application supplied a buffer
+  uint8_t* m_content;                    // m_contentBuffer or the buffer of the application
+  size_t m_contentCapacity;
+  size_t m_contentSize;
+  bool m_isUserContentBuffer;
+  bool m_isDirectPlacement;
+  size_t m_segmentPayloadSize; // of all segments but the last one, with direct placement
 
   // transmission variables
   int m_currentWindowSize;
   int m_interestsInFlight;
   uint64_t m_segNumber;
-  std::unordered_map<uint64_t, int> m_interestRetransmissions;                       // by segment number
-  std::unordered_map<uint64_t, const PendingInterestId*> m_expressedInterests;       // by segment number
-  std::unordered_map<uint64_t, EventId> m_scheduledInterests;                        // by segment number
-  std::unordered_map<uint64_t, time::steady_clock::time_point> m_interestTimepoints; // by segment
+  SegmentRing m_segments; // from the reassembly point on
   RttEstimator m_rttEstimator;
+  time::nanoseconds m_rttSample; // of the last Data, zero if not measured
+  unique_ptr<CongestionController> m_congestionController;
+  int m_congestionControl; // type of m_congestionController
+  uint64_t m_recoveryPoint; // first segment sent after the last window reduction
 
-  // buffers
-  std::map<uint64_t, shared_ptr<const Data>> m_receiveBuffer;         // verified segments by segment number
-  std::map<uint64_t, shared_ptr<const Data>> m_unverifiedSegments;    // used with embedded manifests
+  // buffers (verified segments are kept in m_segments)
+  std::map<uint64_t, shared_ptr<const Data>> m_unverifiedSegments;    // used with embedded manifests and manifest trees
   std::map<uint64_t, shared_ptr<const Manifest>> m_verifiedManifests; // by segment number
 
   // Fast Retransmission
-  std::map<uint64_t, bool> m_receivedSegments;
-  std::unordered_map<uint64_t, bool> m_fastRetxSegments;
+  SegmentScoreboard m_scoreboard;
 };
 
 } // namespace ndn
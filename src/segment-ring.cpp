@@ -0,0 +1,116 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+#include "segment-ring.hpp"
+
+namespace ndn {
+
+SegmentState::SegmentState()
+  : pendingInterest(0)
+  , isInterestScheduled(false)
+  , isRetxTimerSet(false)
+  , nRetransmissions(0)
+  , isPlaced(false)
+{
+}
+
+void
+SegmentState::clear()
+{
+  pendingInterest = 0;
+  isInterestScheduled = false;
+  isRetxTimerSet = false;
+  sendTime = time::steady_clock::TimePoint();
+  nRetransmissions = 0;
+  data.reset();
+  isPlaced = false;
+}
+
+SegmentRing::SegmentRing()
+  : m_slots(2)
+  , m_mask(1)
+  , m_base(0)
+  , m_end(0)
+{
+}
+
+void
+SegmentRing::reset(size_t capacity)
+{
+  for (uint64_t segment = m_base; segment < m_end; segment++) {
+    m_slots[segment & m_mask].clear();
+  }
+
+  m_base = 0;
+  m_end = 0;
+
+  if (capacity > m_slots.size()) {
+    size_t nSlots = m_slots.size();
+    while (nSlots < capacity)
+      nSlots <<= 1;
+
+    m_slots.resize(nSlots);
+    m_mask = nSlots - 1;
+  }
+}
+
+SegmentState*
+SegmentRing::find(uint64_t segment)
+{
+  if (segment < m_base)
+    return nullptr;
+
+  if (segment - m_base > m_mask)
+    grow(segment);
+
+  if (segment >= m_end)
+    m_end = segment + 1;
+
+  return &m_slots[segment & m_mask];
+}
+
+void
+SegmentRing::pop()
+{
+  if (m_base == m_end)
+    m_end++;
+
+  m_slots[m_base & m_mask].clear();
+  m_base++;
+}
+
+void
+SegmentRing::grow(uint64_t segment)
+{
+  size_t nSlots = m_slots.size();
+  while (segment - m_base >= nSlots)
+    nSlots <<= 1;
+
+  std::vector<SegmentState> slots(nSlots);
+  for (uint64_t i = m_base; i < m_end; i++) {
+    std::swap(slots[i & (nSlots - 1)], m_slots[i & m_mask]);
+  }
+
+  m_slots.swap(slots);
+  m_mask = nSlots - 1;
+}
+
+} // namespace ndn
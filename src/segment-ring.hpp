@@ -0,0 +1,116 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+#ifndef SEGMENT_RING_HPP
+#define SEGMENT_RING_HPP
+
+#include "common.hpp"
+
+#include <ndn-cxx/util/scheduler.hpp>
+
+#include <vector>
+
+namespace ndn {
+
+/** \brief represents the state of a segment that was requested but not reassembled yet
+ */
+struct SegmentState
+{
+  SegmentState();
+
+  void
+  clear();
+
+  const PendingInterestId* pendingInterest; // 0 if no Interest is expressed
+  EventId scheduledInterest;                // paced or delayed (Retry-After) Interest
+  bool isInterestScheduled;
+  EventId retxTimer;
+  bool isRetxTimerSet;
+  time::steady_clock::TimePoint sendTime; // of the first transmission, TimePoint() if no sample can be taken
+  int nRetransmissions;
+  shared_ptr<const Data> data; // verified segment (or manifest), waiting for reassembly
+  bool isPlaced;               // payload is in the reassembly buffer, the Data was released
+};
+
+/** \brief keeps the SegmentState of every segment of an ADU in a contiguous ring
+ *
+ *  The ring is indexed by the distance of the segment from the reassembly point (the base),
+ *  so all per-segment bookkeeping is O(1) and does not allocate. The ring is sized to the
+ *  maximum window and grows (to a power of two) only when reassembly falls further behind.
+ *  Segments below the base are reassembled and have no state.
+ */
+class SegmentRing : noncopyable
+{
+public:
+  SegmentRing();
+
+  /** \brief forgets all segments, sets the base to segment zero
+   *  and makes sure that the ring holds at least capacity segments
+   */
+  void
+  reset(size_t capacity);
+
+  /** \brief returns the state of the segment, or nullptr if the segment is below the base
+   */
+  SegmentState*
+  find(uint64_t segment);
+
+  /** \brief clears the state of the base segment and moves the base to the next one
+   */
+  void
+  pop();
+
+  /** \brief returns the first segment that is not reassembled
+   */
+  uint64_t
+  getBase() const;
+
+  /** \brief returns one past the highest segment that has state
+   */
+  uint64_t
+  getEnd() const;
+
+private:
+  void
+  grow(uint64_t segment);
+
+private:
+  std::vector<SegmentState> m_slots;
+  size_t m_mask; // m_slots.size() - 1
+  uint64_t m_base;
+  uint64_t m_end;
+};
+
+inline uint64_t
+SegmentRing::getBase() const
+{
+  return m_base;
+}
+
+inline uint64_t
+SegmentRing::getEnd() const
+{
+  return m_end;
+}
+
+} // namespace ndn
+
+#endif // SEGMENT_RING_HPP
@@ -0,0 +1,208 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+#include "segment-scoreboard.hpp"
+#include "context-default-values.hpp"
+#include "rtt-estimator.hpp"
+
+namespace ndn {
+
+const size_t SegmentScoreboard::INITIAL_CAPACITY;
+
+SegmentScoreboard::SegmentScoreboard()
+  : m_mask(INITIAL_CAPACITY - 1)
+  , m_receivedBits(INITIAL_CAPACITY / 64)
+  , m_lostBits(INITIAL_CAPACITY / 64)
+  , m_sendTimes(INITIAL_CAPACITY)
+  , m_minRtt(time::nanoseconds::zero())
+{
+  reset();
+}
+
+void
+SegmentScoreboard::reset()
+{
+  // keep the capacity that the previous ADU needed
+  std::fill(m_receivedBits.begin(), m_receivedBits.end(), 0);
+  std::fill(m_lostBits.begin(), m_lostBits.end(), 0);
+  std::fill(m_sendTimes.begin(), m_sendTimes.end(), time::steady_clock::TimePoint());
+
+  m_base = 0;
+  m_end = 0;
+  m_highestReceived = 0;
+  m_rackSendTime = time::steady_clock::TimePoint();
+}
+
+void
+SegmentScoreboard::markSent(uint64_t segment, const time::steady_clock::TimePoint& sendTime)
+{
+  if (segment < m_base)
+    return; // already received
+
+  if (segment - m_base > m_mask)
+    grow(segment);
+
+  m_sendTimes[segment & m_mask] = sendTime;
+  m_lostBits[getWord(segment)] &= ~getBit(segment);
+
+  if (segment >= m_end)
+    m_end = segment + 1;
+}
+
+bool
+SegmentScoreboard::markReceived(uint64_t segment)
+{
+  if (isReceived(segment))
+    return false;
+
+  if (segment > m_highestReceived)
+    m_highestReceived = segment;
+
+  if (segment - m_base <= m_mask) {
+    const time::steady_clock::TimePoint& sendTime = m_sendTimes[segment & m_mask];
+    if (sendTime > m_rackSendTime)
+      m_rackSendTime = sendTime;
+  }
+
+  markDone(segment);
+  return true;
+}
+
+void
+SegmentScoreboard::markAbandoned(uint64_t segment)
+{
+  if (!isReceived(segment))
+    markDone(segment);
+}
+
+void
+SegmentScoreboard::markDone(uint64_t segment)
+{
+  if (segment - m_base > m_mask)
+    grow(segment);
+
+  size_t word = getWord(segment);
+  uint64_t bit = getBit(segment);
+  m_receivedBits[word] |= bit;
+  m_lostBits[word] &= ~bit;
+
+  if (segment >= m_end)
+    m_end = segment + 1;
+
+  // slide the window over the segments that are done in order
+  while (m_base < m_end && (m_receivedBits[getWord(m_base)] & getBit(m_base)) != 0) {
+    m_receivedBits[getWord(m_base)] &= ~getBit(m_base);
+    m_sendTimes[m_base & m_mask] = time::steady_clock::TimePoint();
+    m_base++;
+  }
+}
+
+bool
+SegmentScoreboard::isReceived(uint64_t segment) const
+{
+  if (segment < m_base)
+    return true;
+
+  if (segment - m_base > m_mask)
+    return false;
+
+  return (m_receivedBits[getWord(segment)] & getBit(segment)) != 0;
+}
+
+void
+SegmentScoreboard::addRttSample(time::nanoseconds rtt)
+{
+  if (m_minRtt == time::nanoseconds::zero() || rtt < m_minRtt)
+    m_minRtt = rtt;
+}
+
+time::nanoseconds
+SegmentScoreboard::getReorderingWindow() const
+{
+  // a fraction of the minimum RTT (RFC 8985), of the initial RTT estimate before the first sample
+  if (m_minRtt == time::nanoseconds::zero())
+    return time::duration_cast<time::nanoseconds>(RttEstimator::getInitialRtt()) / DEFAULT_REORDERING_WINDOW_FRACTION;
+
+  return m_minRtt / DEFAULT_REORDERING_WINDOW_FRACTION;
+}
+
+void
+SegmentScoreboard::detectLosses(std::vector<uint64_t>& lostSegments)
+{
+  if (m_rackSendTime == time::steady_clock::TimePoint())
+    return; // nothing with a known send time was received
+
+  time::nanoseconds reorderingWindow = getReorderingWindow();
+
+  // only the segments below the highest received one can be missing
+  uint64_t segment = m_base;
+  while (segment < m_highestReceived) {
+    size_t word = getWord(segment);
+
+    // missing and not reported segments of this word, starting from the current one
+    uint64_t holes = ~(m_receivedBits[word] | m_lostBits[word]) & (~static_cast<uint64_t>(0) << (segment & 63));
+    if (holes == 0) {
+      segment = (segment | 63) + 1;
+      continue;
+    }
+
+    segment = (segment & ~static_cast<uint64_t>(63)) + __builtin_ctzll(holes);
+    if (segment >= m_highestReceived)
+      break;
+
+    const time::steady_clock::TimePoint& sendTime = m_sendTimes[segment & m_mask];
+    if (sendTime != time::steady_clock::TimePoint() && sendTime + reorderingWindow < m_rackSendTime) {
+      m_lostBits[word] |= getBit(segment);
+      lostSegments.push_back(segment);
+    }
+
+    segment++;
+  }
+}
+
+void
+SegmentScoreboard::grow(uint64_t segment)
+{
+  size_t capacity = m_mask + 1;
+  while (segment - m_base >= capacity)
+    capacity <<= 1;
+
+  size_t mask = capacity - 1;
+  std::vector<uint64_t> receivedBits(capacity / 64);
+  std::vector<uint64_t> lostBits(capacity / 64);
+  std::vector<time::steady_clock::TimePoint> sendTimes(capacity);
+
+  for (uint64_t i = m_base; i < m_end; i++) {
+    size_t word = (i & mask) >> 6;
+    if ((m_receivedBits[getWord(i)] & getBit(i)) != 0)
+      receivedBits[word] |= getBit(i);
+    if ((m_lostBits[getWord(i)] & getBit(i)) != 0)
+      lostBits[word] |= getBit(i);
+    sendTimes[i & mask] = m_sendTimes[i & m_mask];
+  }
+
+  m_mask = mask;
+  m_receivedBits.swap(receivedBits);
+  m_lostBits.swap(lostBits);
+  m_sendTimes.swap(sendTimes);
+}
+
+} // namespace ndn
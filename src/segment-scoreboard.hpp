@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+#ifndef SEGMENT_SCOREBOARD_HPP
+#define SEGMENT_SCOREBOARD_HPP
+
+#include "common.hpp"
+
+#include <vector>
+
+namespace ndn {
+
+/** \brief keeps track of the received segments of an ADU and detects lost ones
+ *
+ *  The scoreboard is a sliding window of bits anchored at the first segment that was not
+ *  received yet (the reassembly point). The window slides forward as the gap at its start
+ *  is filled, so its memory is bounded by the number of segments in flight, not by the size
+ *  of the ADU. Marking a segment is O(1) amortized.
+ *
+ *  Losses are detected by time, as in RACK: a missing segment is lost when a segment that
+ *  was sent more than a reordering window after it has been received already.
+ *  A lost segment is reported once; it becomes a candidate again after it is sent again.
+ *  A segment that will not be requested any more is abandoned, so that the window slides
+ *  past it.
+ *
+ *  Reference: RFC 8985 "The RACK-TLP Loss Detection Algorithm for TCP"
+ */
+class SegmentScoreboard : noncopyable
+{
+public:
+  SegmentScoreboard();
+
+  /** \brief forgets all segments and anchors the window at segment zero
+   *  The minimum RTT is kept, the next ADU travels the same path.
+   */
+  void
+  reset();
+
+  /** \brief records a transmission (or retransmission) of the segment
+   */
+  void
+  markSent(uint64_t segment, const time::steady_clock::TimePoint& sendTime);
+
+  /** \brief records the reception of the segment
+   *  \return{ false if the segment was received before }
+   */
+  bool
+  markReceived(uint64_t segment);
+
+  /** \brief gives up the segment: it is neither reported as lost nor waited for any more
+   *  The segment counts as received afterwards, but it does not advance loss detection.
+   */
+  void
+  markAbandoned(uint64_t segment);
+
+  bool
+  isReceived(uint64_t segment) const;
+
+  /** \brief updates the minimum RTT, which sizes the reordering window
+   */
+  void
+  addRttSample(time::nanoseconds rtt);
+
+  /** \brief returns how much later than a missing segment another one must have been sent,
+   *  to declare the missing one lost when the other is received
+   */
+  time::nanoseconds
+  getReorderingWindow() const;
+
+  /** \brief appends the missing segments that are considered lost to lostSegments
+   */
+  void
+  detectLosses(std::vector<uint64_t>& lostSegments);
+
+  /** \brief returns the first segment that was not received yet
+   */
+  uint64_t
+  getBase() const;
+
+private:
+  /** \brief marks the segment as done and slides the window over the segments done in order
+   */
+  void
+  markDone(uint64_t segment);
+
+  void
+  grow(uint64_t segment);
+
+  size_t
+  getWord(uint64_t segment) const;
+
+  static uint64_t
+  getBit(uint64_t segment);
+
+private:
+  static const size_t INITIAL_CAPACITY = 1024; // of segments, power of two and multiple of 64
+
+  size_t m_mask; // capacity - 1
+  uint64_t m_base;
+  uint64_t m_end; // one past the highest segment in the window
+  uint64_t m_highestReceived;
+  std::vector<uint64_t> m_receivedBits;
+  std::vector<uint64_t> m_lostBits; // reported and not sent again
+  std::vector<time::steady_clock::TimePoint> m_sendTimes; // of the last transmission
+
+  // send time of the most recently sent segment among the received ones
+  time::steady_clock::TimePoint m_rackSendTime;
+  time::nanoseconds m_minRtt; // zero until the first sample
+};
+
+inline uint64_t
+SegmentScoreboard::getBase() const
+{
+  return m_base;
+}
+
+inline size_t
+SegmentScoreboard::getWord(uint64_t segment) const
+{
+  return (segment & m_mask) >> 6;
+}
+
+inline uint64_t
+SegmentScoreboard::getBit(uint64_t segment)
+{
+  return static_cast<uint64_t>(1) << (segment & 63);
+}
+
+} // namespace ndn
+
+#endif // SEGMENT_SCOREBOARD_HPP
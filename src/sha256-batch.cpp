@@ -0,0 +1,477 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#include "sha256-batch.hpp"
+
+#include <ndn-cxx/util/sha256.hpp>
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA256_BATCH_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace ndn {
+
+namespace {
+
+const size_t BLOCK_SIZE = 64;
+const size_t DIGEST_SIZE = 32;
+const size_t MAX_LANES = 16;
+
+const uint32_t K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t INITIAL_STATE[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+inline uint32_t
+loadBigEndian32(const uint8_t* p)
+{
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline void
+storeBigEndian32(uint8_t* p, uint32_t value)
+{
+  p[0] = static_cast<uint8_t>(value >> 24);
+  p[1] = static_cast<uint8_t>(value >> 16);
+  p[2] = static_cast<uint8_t>(value >> 8);
+  p[3] = static_cast<uint8_t>(value);
+}
+
+// message, 0x80 byte and 64-bit length, rounded up to whole blocks
+inline size_t
+getNumberOfBlocks(size_t messageSize)
+{
+  return (messageSize + 9 + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+// copies the block with the given index of the padded message into block
+void
+getPaddedBlock(const uint8_t* buf, size_t size, size_t index, uint8_t* block)
+{
+  size_t offset = index * BLOCK_SIZE;
+  size_t nBytes = (offset < size) ? std::min(size - offset, BLOCK_SIZE) : 0;
+
+  if (nBytes > 0)
+    memcpy(block, buf + offset, nBytes);
+  memset(block + nBytes, 0, BLOCK_SIZE - nBytes);
+
+  if (size >= offset && size < offset + BLOCK_SIZE)
+    block[size - offset] = 0x80;
+
+  if (index == getNumberOfBlocks(size) - 1) {
+    uint64_t nBits = static_cast<uint64_t>(size) * 8;
+    storeBigEndian32(block + 56, static_cast<uint32_t>(nBits >> 32));
+    storeBigEndian32(block + 60, static_cast<uint32_t>(nBits));
+  }
+}
+
+#ifdef SHA256_BATCH_X86
+
+typedef uint32_t Vec4 __attribute__((vector_size(16)));
+typedef uint32_t Vec8 __attribute__((vector_size(32)));
+typedef uint32_t Vec16 __attribute__((vector_size(64)));
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/* Multi-buffer SHA-256: lane k of every vector belongs to message k.
+ * Lanes whose message is shorter than the longest one in the batch keep
+ * their state unchanged for the remaining blocks.
+ * Always inlined into the target-specific wrappers below, so that the vector
+ * code is generated with the instruction set of the wrapper.
+ */
+template<typename V, size_t N>
+inline __attribute__((always_inline)) void
+hashLanes(const uint8_t* const* bufs, const size_t* sizes, size_t nBuffers, uint8_t* digests)
+{
+  static const uint8_t emptyBlock[BLOCK_SIZE] = {0};
+
+  V zero = {};
+  V state[8];
+  for (size_t i = 0; i < 8; i++)
+    state[i] = zero + INITIAL_STATE[i];
+
+  size_t nBlocks[N];
+  size_t maxBlocks = 0;
+  for (size_t k = 0; k < N; k++) {
+    nBlocks[k] = (k < nBuffers) ? getNumberOfBlocks(sizes[k]) : 0;
+    maxBlocks = std::max(maxBlocks, nBlocks[k]);
+  }
+
+  uint8_t padded[N][BLOCK_SIZE];
+
+  for (size_t b = 0; b < maxBlocks; b++) {
+    uint32_t words[16][N];
+    uint32_t activeLanes[N];
+
+    // transpose the current block of each message into the lanes
+    for (size_t k = 0; k < N; k++) {
+      const uint8_t* block = emptyBlock;
+      activeLanes[k] = 0;
+
+      if (b < nBlocks[k]) {
+        activeLanes[k] = 0xffffffff;
+
+        if ((b + 1) * BLOCK_SIZE <= sizes[k]) {
+          block = bufs[k] + b * BLOCK_SIZE;
+        }
+        else {
+          getPaddedBlock(bufs[k], sizes[k], b, padded[k]);
+          block = padded[k];
+        }
+      }
+
+      for (size_t t = 0; t < 16; t++)
+        words[t][k] = loadBigEndian32(block + 4 * t);
+    }
+
+    V w[16];
+    for (size_t t = 0; t < 16; t++)
+      memcpy(&w[t], words[t], sizeof(V));
+
+    V isActive;
+    memcpy(&isActive, activeLanes, sizeof(V));
+
+    V a = state[0], b_ = state[1], c = state[2], d = state[3];
+    V e = state[4], f = state[5], g = state[6], h = state[7];
+
+#pragma GCC unroll 64
+    for (size_t t = 0; t < 64; t++) {
+      if (t >= 16) {
+        V w15 = w[(t - 15) & 15];
+        V w2 = w[(t - 2) & 15];
+        V s0 = ROTR(w15, 7) ^ ROTR(w15, 18) ^ (w15 >> 3);
+        V s1 = ROTR(w2, 17) ^ ROTR(w2, 19) ^ (w2 >> 10);
+        w[t & 15] = w[t & 15] + s0 + w[(t - 7) & 15] + s1;
+      }
+
+      V t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + K[t] + w[t & 15];
+      V t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b_) ^ (a & c) ^ (b_ & c));
+
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b_;
+      b_ = a;
+      a = t1 + t2;
+    }
+
+    V result[8] = {a, b_, c, d, e, f, g, h};
+    for (size_t i = 0; i < 8; i++)
+      state[i] = ((state[i] + result[i]) & isActive) | (state[i] & ~isActive);
+  }
+
+  for (size_t k = 0; k < nBuffers; k++) {
+    for (size_t i = 0; i < 8; i++)
+      storeBigEndian32(digests + k * DIGEST_SIZE + 4 * i, state[i][k]);
+  }
+}
+
+#undef ROTR
+
+__attribute__((target("sse2"))) void
+hashLanesSse2(const uint8_t* const* bufs, const size_t* sizes, size_t nBuffers, uint8_t* digests)
+{
+  hashLanes<Vec4, 4>(bufs, sizes, nBuffers, digests);
+}
+
+__attribute__((target("avx2"))) void
+hashLanesAvx2(const uint8_t* const* bufs, const size_t* sizes, size_t nBuffers, uint8_t* digests)
+{
+  hashLanes<Vec8, 8>(bufs, sizes, nBuffers, digests);
+}
+
+__attribute__((target("avx512f"))) void
+hashLanesAvx512(const uint8_t* const* bufs, const size_t* sizes, size_t nBuffers, uint8_t* digests)
+{
+  hashLanes<Vec16, 16>(bufs, sizes, nBuffers, digests);
+}
+
+// Reference: "Intel SHA Extensions", Intel white paper, 2013
+__attribute__((target("sha,sse4.1"))) void
+compressShaNi(uint32_t* state, const uint8_t* data, size_t nBlocks)
+{
+  const __m128i byteSwapMask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  // state is kept as ABEF and CDGH
+  __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+  __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+  for (size_t block = 0; block < nBlocks; block++, data += BLOCK_SIZE) {
+    __m128i savedState0 = state0;
+    __m128i savedState1 = state1;
+    __m128i w[4];
+
+#pragma GCC unroll 16
+    for (size_t group = 0; group < 16; group++) {
+      __m128i& current = w[group & 3];
+
+      if (group < 4) {
+        current = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * group)),
+                                   byteSwapMask);
+      }
+      else {
+        // W[t-16] + sigma0(W[t-15]) + W[t-7] + sigma1(W[t-2]) for four rounds
+        __m128i sum = _mm_sha256msg1_epu32(w[group & 3], w[(group + 1) & 3]);
+        sum = _mm_add_epi32(sum, _mm_alignr_epi8(w[(group + 3) & 3], w[(group + 2) & 3], 4));
+        current = _mm_sha256msg2_epu32(sum, w[(group + 3) & 3]);
+      }
+
+      __m128i message = _mm_add_epi32(current, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&K[4 * group])));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0E));
+    }
+
+    state0 = _mm_add_epi32(state0, savedState0);
+    state1 = _mm_add_epi32(state1, savedState1);
+  }
+
+  // back to ABCD and EFGH
+  tmp = _mm_shuffle_epi32(state0, 0x1B);
+  state1 = _mm_shuffle_epi32(state1, 0xB1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+void
+hashShaNi(const uint8_t* buf, size_t size, uint8_t* digest)
+{
+  uint32_t state[8];
+  memcpy(state, INITIAL_STATE, sizeof(state));
+
+  size_t nFullBlocks = size / BLOCK_SIZE;
+  compressShaNi(state, buf, nFullBlocks);
+
+  // the tail and the padding take one or two blocks
+  uint8_t tail[2 * BLOCK_SIZE];
+  size_t nTailBlocks = getNumberOfBlocks(size) - nFullBlocks;
+  for (size_t i = 0; i < nTailBlocks; i++)
+    getPaddedBlock(buf, size, nFullBlocks + i, tail + i * BLOCK_SIZE);
+  compressShaNi(state, tail, nTailBlocks);
+
+  for (size_t i = 0; i < 8; i++)
+    storeBigEndian32(digest + 4 * i, state[i]);
+}
+
+bool
+detectShaNi()
+{
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1))
+    return false;
+
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return false;
+
+  return (ebx & (1 << 29)) != 0; // SHA
+}
+
+bool
+isShaNiSupported()
+{
+  // cpuid is expensive under virtualization, ask only once
+  static const bool isSupported = detectShaNi();
+  return isSupported;
+}
+
+#endif // SHA256_BATCH_X86
+
+} // namespace
+
+Sha256Batch::Sha256Batch()
+  : m_kernel(detectKernel())
+{
+}
+
+Sha256Batch::Sha256Batch(Kernel kernel)
+  : m_kernel(isSupported(kernel) ? kernel : KERNEL_SCALAR)
+{
+}
+
+void
+Sha256Batch::add(const uint8_t* buf, size_t size)
+{
+  Input input = {buf, size};
+  m_inputs.push_back(input);
+}
+
+void
+Sha256Batch::add(const Block& block)
+{
+  add(block.wire(), block.size());
+}
+
+void
+Sha256Batch::clear()
+{
+  m_inputs.clear();
+}
+
+std::vector<ConstBufferPtr>
+Sha256Batch::compute()
+{
+  std::vector<ConstBufferPtr> digests;
+  digests.reserve(m_inputs.size());
+
+  switch (m_kernel) {
+#ifdef SHA256_BATCH_X86
+  case KERNEL_SHA_NI: {
+    for (const Input& input : m_inputs) {
+      shared_ptr<Buffer> digest = make_shared<Buffer>(DIGEST_SIZE);
+      hashShaNi(input.buf, input.size, digest->data());
+      digests.push_back(digest);
+    }
+    break;
+  }
+  case KERNEL_SSE2:
+  case KERNEL_AVX2:
+  case KERNEL_AVX512: {
+    size_t width = getWidth(m_kernel);
+    const uint8_t* bufs[MAX_LANES];
+    size_t sizes[MAX_LANES];
+    uint8_t output[MAX_LANES * DIGEST_SIZE];
+
+    for (size_t first = 0; first < m_inputs.size(); first += width) {
+      size_t nBuffers = std::min(width, m_inputs.size() - first);
+      for (size_t k = 0; k < nBuffers; k++) {
+        bufs[k] = m_inputs[first + k].buf;
+        sizes[k] = m_inputs[first + k].size;
+      }
+
+      if (m_kernel == KERNEL_AVX512)
+        hashLanesAvx512(bufs, sizes, nBuffers, output);
+      else if (m_kernel == KERNEL_AVX2)
+        hashLanesAvx2(bufs, sizes, nBuffers, output);
+      else
+        hashLanesSse2(bufs, sizes, nBuffers, output);
+
+      for (size_t k = 0; k < nBuffers; k++)
+        digests.push_back(make_shared<Buffer>(output + k * DIGEST_SIZE, DIGEST_SIZE));
+    }
+    break;
+  }
+#endif // SHA256_BATCH_X86
+  default: {
+    for (const Input& input : m_inputs)
+      digests.push_back(util::Sha256::computeDigest(input.buf, input.size));
+    break;
+  }
+  }
+
+  m_inputs.clear();
+  return digests;
+}
+
+Sha256Batch::Kernel
+Sha256Batch::detectKernel()
+{
+  // a full batch of 16 lanes is faster than SHA extensions, and SHA extensions are faster
+  // than 8 lanes; 4 lanes of SSE2 are slower than scalar code, so they are never picked
+  static const Kernel preferred[] = {KERNEL_AVX512, KERNEL_SHA_NI, KERNEL_AVX2};
+
+  static const Kernel detected = [] {
+    for (Kernel kernel : preferred) {
+      if (isSupported(kernel))
+        return kernel;
+    }
+    return KERNEL_SCALAR;
+  }();
+
+  return detected;
+}
+
+bool
+Sha256Batch::isSupported(Kernel kernel)
+{
+  switch (kernel) {
+#ifdef SHA256_BATCH_X86
+  case KERNEL_SSE2:
+    return __builtin_cpu_supports("sse2");
+  case KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2");
+  case KERNEL_AVX512:
+    return __builtin_cpu_supports("avx512f");
+  case KERNEL_SHA_NI:
+    return isShaNiSupported();
+#endif // SHA256_BATCH_X86
+  case KERNEL_SCALAR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+size_t
+Sha256Batch::getWidth(Kernel kernel)
+{
+  switch (kernel) {
+  case KERNEL_SSE2:
+    return 4;
+  case KERNEL_AVX2:
+    return 8;
+  case KERNEL_AVX512:
+    return 16;
+  default:
+    return 1;
+  }
+}
+
+const char*
+Sha256Batch::getKernelName(Kernel kernel)
+{
+  switch (kernel) {
+  case KERNEL_SSE2:
+    return "SSE2 x4";
+  case KERNEL_AVX2:
+    return "AVX2 x8";
+  case KERNEL_AVX512:
+    return "AVX-512 x16";
+  case KERNEL_SHA_NI:
+    return "SHA-NI";
+  default:
+    return "scalar";
+  }
+}
+
+} // namespace ndn
@@ -0,0 +1,133 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014-2017 Regents of the University of California.
+ *
+ * This file is part of Consumer/Producer API library.
+ *
+ * Consumer/Producer API library library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any later version.
+ *
+ * Consumer/Producer API library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received copies of the GNU General Public License and GNU Lesser
+ * General Public License along with Consumer/Producer API, e.g., in COPYING.md file.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * See AUTHORS.md for complete list of Consumer/Producer API authors and contributors.
+ */
+
+
+#ifndef SHA256_BATCH_HPP
+#define SHA256_BATCH_HPP
+
+#include "common.hpp"
+
+#include <vector>
+
+namespace ndn {
+
+/** \brief computes SHA-256 digests of many independent buffers at once
+ *
+ *  Segments of one ADU have (almost) the same size, so their digests can be computed
+ *  in lockstep: multi-buffer kernels keep 4, 8 or 16 messages in the lanes of one
+ *  SIMD register and run the compression function on all of them together.
+ *  When the CPU implements SHA extensions, the buffers are hashed one by one with
+ *  the dedicated instructions instead, which is faster than any multi-buffer kernel.
+ *
+ *  The kernel is selected at runtime according to CPU features; the scalar kernel
+ *  (util::Sha256) is used on CPUs without SIMD support and on non-x86 platforms.
+ *
+ *  Buffers are not copied: they must stay valid until compute() returns.
+ */
+class Sha256Batch : noncopyable
+{
+public:
+  enum Kernel {
+    KERNEL_SCALAR = 0, // util::Sha256, one buffer at a time
+    KERNEL_SSE2 = 1,   // 4 buffers at a time
+    KERNEL_AVX2 = 2,   // 8 buffers at a time
+    KERNEL_AVX512 = 3, // 16 buffers at a time
+    KERNEL_SHA_NI = 4  // SHA extensions, one buffer at a time
+  };
+
+  /** \brief creates a batch that uses the fastest kernel supported by the CPU
+   */
+  Sha256Batch();
+
+  /** \brief creates a batch that uses a specific kernel
+   *  Falls back to the scalar kernel if the CPU does not support the requested one.
+   */
+  explicit Sha256Batch(Kernel kernel);
+
+  /** \brief schedules a buffer for hashing
+   */
+  void
+  add(const uint8_t* buf, size_t size);
+
+  /** \brief schedules the wire encoding of a block for hashing
+   */
+  void
+  add(const Block& block);
+
+  /** \brief computes digests of all scheduled buffers and clears the batch
+   *  \return{ digests in the order the buffers were added }
+   */
+  std::vector<ConstBufferPtr>
+  compute();
+
+  /** \brief returns the number of scheduled buffers
+   */
+  size_t
+  size() const;
+
+  void
+  clear();
+
+  Kernel
+  getKernel() const;
+
+  /** \brief returns the fastest kernel supported by the CPU
+   */
+  static Kernel
+  detectKernel();
+
+  static bool
+  isSupported(Kernel kernel);
+
+  /** \brief returns the number of buffers a kernel hashes at a time
+   */
+  static size_t
+  getWidth(Kernel kernel);
+
+  static const char*
+  getKernelName(Kernel kernel);
+
+private:
+  struct Input
+  {
+    const uint8_t* buf;
+    size_t size;
+  };
+
+  Kernel m_kernel;
+  std::vector<Input> m_inputs;
+};
+
+inline size_t
+Sha256Batch::size() const
+{
+  return m_inputs.size();
+}
+
+inline Sha256Batch::Kernel
+Sha256Batch::getKernel() const
+{
+  return m_kernel;
+}
+
+} // namespace ndn
+
+#endif // SHA256_BATCH_HPP
@@ -32,6 +32,7 @@ UnreliableDataRetrieval::UnreliableDataRetrieval(Context* context)
   , m_segNumber(0)
   , m_currentWindowSize(0)
   , m_interestsInFlight(0)
+  , m_congestionControl(-1)
 {
   context->getContextOption(FACE, m_face);
 }
@@ -46,6 +47,11 @@ UnreliableDataRetrieval::start()
   m_segNumber = 0;
   m_interestsInFlight = 0;
   m_currentWindowSize = 0;
+  m_interestTimepoints.clear();
+  m_nRetransmissions.clear();
+  m_scoreboard.reset();
+
+  setupCongestionControl();
 
   // this is to support window size "inheritance" between consume calls
   /*int currentWindowSize = -1;
@@ -124,6 +130,8 @@ UnreliableDataRetrieval::sendInterest()
   }
 
   m_interestsInFlight++;
+  m_interestTimepoints[m_segNumber] = time::steady_clock::now();
+  m_scoreboard.markSent(m_segNumber, m_interestTimepoints[m_segNumber]);
   m_expressedInterests[m_segNumber] = m_face->expressInterest(interest,
                                                               bind(&UnreliableDataRetrieval::onData, this, _1, _2),
                                                               bind(&UnreliableDataRetrieval::onNack, this, _1, _2),
@@ -147,6 +155,15 @@ UnreliableDataRetrieval::onData(const Interest& interest, const Data& data)
 
   m_interestsInFlight--;
 
+  time::nanoseconds rtt = time::nanoseconds::zero();
+  uint64_t segment = interest.getName().get(-1).toSegment();
+  auto timepoint = m_interestTimepoints.find(segment);
+  if (timepoint != m_interestTimepoints.end()) {
+    rtt = time::duration_cast<time::nanoseconds>(time::steady_clock::now() - timepoint->second);
+    m_scoreboard.addRttSample(rtt);
+    m_interestTimepoints.erase(timepoint);
+  }
+
   ConsumerDataCallback onDataEnteredContext = EMPTY_CALLBACK;
   m_context->getContextOption(DATA_ENTER_CNTX, onDataEnteredContext);
   if (onDataEnteredContext != EMPTY_CALLBACK) {
@@ -177,11 +194,8 @@ UnreliableDataRetrieval::onData(const Interest& interest, const Data& data)
     checkFastRetransmissionConditions(interest);
 
     if (data.getContentType() == CONTENT_DATA_TYPE) {
-      int maxWindowSize = -1;
-      m_context->getContextOption(MAX_WINDOW_SIZE, maxWindowSize);
-      if (m_currentWindowSize < maxWindowSize) {
-        m_currentWindowSize++;
-      }
+      m_congestionController->afterData(rtt);
+      m_currentWindowSize = m_congestionController->getWindowSize();
 
       if (!data.getFinalBlockId().empty()) {
         m_isFinalBlockNumberDiscovered = true;
@@ -197,13 +211,8 @@ UnreliableDataRetrieval::onData(const Interest& interest, const Data& data)
       }
     }
     else if (data.getContentType() == NACK_DATA_TYPE) {
-      int minWindowSize = -1;
-      m_context->getContextOption(MIN_WINDOW_SIZE, minWindowSize);
-      if (m_currentWindowSize > minWindowSize) {
-        m_currentWindowSize = m_currentWindowSize / 2; // cut in half
-        if (m_currentWindowSize == 0)
-          m_currentWindowSize++;
-      }
+      m_congestionController->afterLoss();
+      m_currentWindowSize = m_congestionController->getWindowSize();
 
       shared_ptr<ApplicationNack> nack = make_shared<ApplicationNack>(data);
 
@@ -258,13 +267,14 @@ UnreliableDataRetrieval::onTimeout(const Interest& interest)
 
   m_interestsInFlight--;
 
-  int minWindowSize = -1;
-  m_context->getContextOption(MIN_WINDOW_SIZE, minWindowSize);
-  if (m_currentWindowSize > minWindowSize) {
-    m_currentWindowSize = m_currentWindowSize / 2; // cut in half
-    if (m_currentWindowSize == 0)
-      m_currentWindowSize++;
-  }
+  // timed out segments are not requested again
+  uint64_t segment = interest.getName().get(-1).toSegment();
+  m_interestTimepoints.erase(segment);
+  m_nRetransmissions.erase(segment);
+  m_scoreboard.markAbandoned(segment);
+
+  m_congestionController->afterLoss();
+  m_currentWindowSize = m_congestionController->getWindowSize();
 
   ConsumerInterestCallback onInterestExpired = EMPTY_CALLBACK;
   m_context->getContextOption(INTEREST_EXPIRED, onInterestExpired);
@@ -301,40 +311,62 @@ UnreliableDataRetrieval::onTimeout(const Interest& interest)
   }
 }
 
+void
+UnreliableDataRetrieval::setupCongestionControl()
+{
+  int congestionControl = DEFAULT_CONGESTION_CONTROL;
+  m_context->getContextOption(CONGESTION_CONTROL, congestionControl);
+
+  if (!static_cast<bool>(m_congestionController) || congestionControl != m_congestionControl) {
+    m_congestionController = CongestionController::create(congestionControl);
+    if (!static_cast<bool>(m_congestionController)) {
+      congestionControl = DEFAULT_CONGESTION_CONTROL;
+      m_congestionController = CongestionController::create(congestionControl);
+    }
+    m_congestionControl = congestionControl;
+  }
+
+  int minWindowSize = -1;
+  m_context->getContextOption(MIN_WINDOW_SIZE, minWindowSize);
+  int maxWindowSize = -1;
+  m_context->getContextOption(MAX_WINDOW_SIZE, maxWindowSize);
+  m_congestionController->setLimits(minWindowSize, maxWindowSize);
+
+  // every ADU starts with a single Interest
+  m_congestionController->reset();
+}
+
 void
 UnreliableDataRetrieval::checkFastRetransmissionConditions(const Interest& interest)
 {
   uint64_t segNumber = interest.getName().get(-1).toSegment();
-  m_receivedSegments[segNumber] = true;
-  m_fastRetxSegments.erase(segNumber);
+  if (!m_scoreboard.markReceived(segNumber))
+    return; // a duplicate does not tell anything new
 
-  uint64_t possiblyLostSegment = 0;
-  uint64_t highestReceivedSegment = m_receivedSegments.rbegin()->first;
+  m_nRetransmissions.erase(segNumber);
 
-  for (uint64_t i = 0; i <= highestReceivedSegment; i++) {
-    if (m_receivedSegments.find(i) == m_receivedSegments.end()) // segment is not received yet
-    {
-      // segment has not been fast retransmitted yet
-      if (m_fastRetxSegments.find(i) == m_fastRetxSegments.end()) {
-        possiblyLostSegment = i;
-        uint8_t nOutOfOrderSegments = 0;
-        for (uint64_t j = i; j <= highestReceivedSegment; j++) {
-          if (m_receivedSegments.find(j) != m_receivedSegments.end()) {
-            nOutOfOrderSegments++;
-            if (nOutOfOrderSegments == DEFAULT_FAST_RETX_CONDITION) {
-              m_fastRetxSegments[possiblyLostSegment] = true;
-              fastRetransmit(interest, possiblyLostSegment);
-            }
-          }
-        }
-      }
-    }
+  std::vector<uint64_t> lostSegments;
+  m_scoreboard.detectLosses(lostSegments);
+  for (uint64_t lostSegment : lostSegments) {
+    fastRetransmit(interest, lostSegment);
   }
 }
 
 void
 UnreliableDataRetrieval::fastRetransmit(const Interest& interest, uint64_t segNumber)
 {
+  int maxRetransmissions;
+  m_context->getContextOption(INTEREST_RETX, maxRetransmissions);
+
+  // a segment that keeps getting lost would pin the scoreboard window
+  int& nRetransmissions = m_nRetransmissions[segNumber];
+  if (nRetransmissions >= maxRetransmissions) {
+    m_nRetransmissions.erase(segNumber);
+    m_scoreboard.markAbandoned(segNumber);
+    return;
+  }
+  nRetransmissions++;
+
   Name name = interest.getName().getPrefix(-1);
   name.appendSegment(segNumber);
 
@@ -356,6 +388,8 @@ UnreliableDataRetrieval::fastRetransmit(const Interest& interest, uint64_t segNu
 
   //retransmit
   m_interestsInFlight++;
+  m_interestTimepoints.erase(segNumber); // a sample of the retransmission would be ambiguous
+  m_scoreboard.markSent(segNumber, time::steady_clock::now());
   m_expressedInterests[m_segNumber] = m_face->expressInterest(retxInterest,
                                                               bind(&UnreliableDataRetrieval::onData, this, _1, _2),
                                                               bind(&UnreliableDataRetrieval::onNack, this, _1, _2),
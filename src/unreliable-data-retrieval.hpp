@@ -22,7 +22,10 @@
 #ifndef UNRELIABLE_DATA_RETRIEVAL_HPP
 #define UNRELIABLE_DATA_RETRIEVAL_HPP
 
+#include "congestion-controller.hpp"
 #include "data-retrieval-protocol.hpp"
+#include "rtt-estimator.hpp"
+#include "segment-scoreboard.hpp"
 #include "selector-helper.hpp"
 
 namespace ndn {
@@ -59,15 +62,26 @@ private:
   void
   onTimeout(const Interest& interest);
 
+  /** \brief marks the segment of the Interest as received and fast retransmits the segments
+   *  that are detected as lost
+   */
   void
   checkFastRetransmissionConditions(const Interest& interest);
 
+  /** \brief retransmits a lost segment, or abandons it after INTEREST_RETX retransmissions
+   */
   void
   fastRetransmit(const Interest& interest, uint64_t segNumber);
 
   void
   removeAllPendingInterests();
 
+  /** \brief creates the controller selected by CONGESTION_CONTROL (if it changed)
+   *  and resets it for a new ADU
+   */
+  void
+  setupCongestionControl();
+
 private:
   bool m_isFinalBlockNumberDiscovered;
   int m_nTimeouts;
@@ -79,10 +93,13 @@ private:
   int m_interestsInFlight;
 
   std::unordered_map<uint64_t, const PendingInterestId*> m_expressedInterests; // by segment number
+  std::unordered_map<uint64_t, time::steady_clock::TimePoint> m_interestTimepoints; // by segment number
+  unique_ptr<CongestionController> m_congestionController;
+  int m_congestionControl; // type of m_congestionController
 
   // Fast Retransmission
-  std::map<uint64_t, bool> m_receivedSegments;
-  std::map<uint64_t, bool> m_fastRetxSegments;
+  SegmentScoreboard m_scoreboard;
+  std::unordered_map<uint64_t, int> m_nRetransmissions; // by segment number
 };
 
 } // namespace ndn